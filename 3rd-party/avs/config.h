@@ -78,4 +78,6 @@
 #   define __forceinline inline
 #endif
 
+#include "posix.h"
+
 #endif //AVS_CONFIG_H
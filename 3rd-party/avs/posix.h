@@ -0,0 +1,19 @@
+// Definitions of the MSVC specific keywords and types used by avisynth.h,
+// for building plugins with GCC/Clang on POSIX systems (AviSynth+ on Linux, macOS and BSD).
+
+#ifndef AVS_POSIX_H
+#define AVS_POSIX_H
+
+#ifndef _WIN32
+
+#include <stdint.h>
+
+#define __stdcall
+#define __cdecl
+#define __declspec(x)
+
+typedef int64_t __int64;
+
+#endif // _WIN32
+
+#endif // AVS_POSIX_H
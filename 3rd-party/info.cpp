@@ -1,9 +1,17 @@
 // original IT0051 by thejam79
 // add YV12 mode by minamina 2003/05/01
 // Borrowed and adapted from Fizicks Depan 1.10.1 plugin
+#include <emmintrin.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
 #include "info.h"
 
-unsigned short font[][20] = {
+#define GLYPH_WIDTH  10
+#define GLYPH_HEIGHT 20
+#define GLYPH_COUNT  (int)(sizeof(font) / sizeof(font[0]))
+
+static const unsigned short font[][20] = {
 	//STARTCHAR space
 	{
 		0x0000,0x0000,0x0000,0x0000,
@@ -1542,35 +1550,83 @@ unsigned short font[][20] = {
 	}
 };
 
-void DrawDigit(PVideoFrame &dst, int x, int y, int num, int bYUY2) 
-{
-	x = x * 10;
-	y = y * 20;
-
-	int step = bYUY2 + 1;
+// Every glyph expanded to one byte per pixel, 0xFF where it is lit, once per frame layout: one byte
+// per pixel for planar luma, every other byte for YUY2. Built on first use.
+struct GlyphAtlas {
+	unsigned char lit[2][GLYPH_COUNT][GLYPH_HEIGHT][GLYPH_WIDTH * 2];
 
-	int pitch = dst->GetPitch();
-	for (int tx = 0; tx < 10; tx++) {
-		for (int ty = 0; ty < 20; ty++) {
-			unsigned char *dp = &dst->GetWritePtr()[(x + tx) * step + (y + ty) * pitch];
-			if (font[num][ty] & (1 << (15 - tx))) {
-				dp[0] = 250;
-			} else {
-				dp[0] = (dp[0] * 4) >> 3;
+	GlyphAtlas() {
+		memset(lit, 0, sizeof(lit));
+		for (int g = 0; g < GLYPH_COUNT; g++) {
+			for (int ty = 0; ty < GLYPH_HEIGHT; ty++) {
+				for (int tx = 0; tx < GLYPH_WIDTH; tx++) {
+					unsigned char on = (font[g][ty] & (1 << (15 - tx))) ? 0xFF : 0;
+					lit[0][g][ty][tx] = on;
+					lit[1][g][ty][tx * 2] = on;
+				}
 			}
 		}
 	}
+};
+
+static const GlyphAtlas& glyphAtlas() {
+	static const GlyphAtlas atlas;
+	return atlas;
+}
+
+// Lit bytes become 250 and the other luma bytes are halved, which dims the background of the text.
+// YUY2 chroma bytes are kept.
+static void BlendRow(unsigned char *dp, const unsigned char *lit, int bytes, int bYUY2, bool sse2)
+{
+	int x = 0;
+	if (sse2) {
+		const __m128i text = _mm_set1_epi8((char)250);
+		const __m128i low7 = _mm_set1_epi8(0x7f);
+		const __m128i luma = bYUY2 ? _mm_set1_epi16(0x00ff) : _mm_set1_epi8(-1);
+		for (; x + 16 <= bytes; x += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dp + x));
+			__m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lit + x));
+			__m128i half = _mm_and_si128(_mm_srli_epi16(p, 1), low7);
+			__m128i dimmed = _mm_or_si128(_mm_and_si128(luma, half), _mm_andnot_si128(luma, p));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dp + x), _mm_or_si128(_mm_and_si128(m, text), _mm_andnot_si128(m, dimmed)));
+		}
+	}
+	for (; x < bytes; x++) {
+		if (bYUY2 && (x & 1)) continue;
+		dp[x] = lit[x] ? 250 : dp[x] >> 1;
+	}
 }
 
-void _DrawString(PVideoFrame &dst, int x, int y, const char *s, int bYUY2)
+// Draws s at character cell (x, y), row by row, cropped to the frame.
+void _DrawString(PVideoFrame &dst, int x, int y, const char *s, int bYUY2, int cpuFlags)
 {
-	for (int xx = 0; *s; ++s, ++xx) {
-		DrawDigit(dst, x + xx, y, *s - ' ', bYUY2);
+	const int step = bYUY2 ? 2 : 1;
+	const int glyphBytes = GLYPH_WIDTH * step;
+	const int left = x * glyphBytes;
+	const int top = y * GLYPH_HEIGHT;
+	const int rowSize = dst->GetRowSize();
+	const int pitch = dst->GetPitch();
+	const int rows = std::min(GLYPH_HEIGHT, dst->GetHeight() - top);
+
+	int count = 0;
+	while (s[count] && left + (count + 1) * glyphBytes <= rowSize) count++;
+	if (count == 0 || rows <= 0) return;
+
+	const GlyphAtlas& atlas = glyphAtlas();
+	std::vector<unsigned char> lit(count * glyphBytes);
+	unsigned char *dp = dst->GetWritePtr() + top * pitch + left;
+	for (int ty = 0; ty < rows; ty++, dp += pitch) {
+		for (int i = 0; i < count; i++) {
+			int g = (unsigned char)s[i] - ' ';
+			if (g < 0 || g >= GLYPH_COUNT) g = 0;
+			memcpy(&lit[i * glyphBytes], atlas.lit[bYUY2 ? 1 : 0][g][ty], glyphBytes);
+		}
+		BlendRow(dp, lit.data(), count * glyphBytes, bYUY2, (cpuFlags & CPUF_SSE2) != 0);
 	}
 }
 
 // Wraps text line if needed, and crops it so it doesn't overflow the image area
-void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bYUY2)
+void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bYUY2, int cpuFlags)
 {
 	int header = 6;      // number of rows for non-frame lines in first column
 	int colChars = 22;   // number characters per diff columns per
@@ -1581,13 +1637,13 @@ void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bYUY2)
 	int col = y / rows;  // number of raw text columns
 
 	if (col == 0) {
-		_DrawString(dst, x, y, s, bYUY2);      // draw first column normally, as it has headers as well
+		_DrawString(dst, x, y, s, bYUY2, cpuFlags);      // draw first column normally, as it has headers as well
 	}
 	else {                                     // Special handling for diff column 1+
 		col = (y - header) / (rows - header);  // compute diff column number
 		y += col * header;                     // add whitespace padding to top of diff columns 1-N
 		if (col * colChars * charWidth < w) {  // overflow protection for drawing
-			_DrawString(dst, col * colChars, y % rows, s, bYUY2);
+			_DrawString(dst, col * colChars, y % rows, s, bYUY2, cpuFlags);
 		}
 	}
 }
@@ -2,7 +2,8 @@
 
 #pragma once
 
-#include "windows.h" 
 #include "avisynth.h"
 
-void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bIsYUY2); 
+// Draws s on the luma of a YV12 or YUY2 frame, at character cell (x, y) of 10x20 pixel cells.
+// cpuFlags are CPUF_* flags, CPUF_SSE2 blends 16 bytes at a time.
+void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bIsYUY2, int cpuFlags); 
@@ -0,0 +1,133 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AnalysisFile.h"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+#define CLASSIFY_BATCH 64   // cycles ranked together by classifyFrames
+
+static void loadCycle(Cycle& cycle, int start, const float* diffs, int count) {
+	cycle.reset();
+	for (int i = 0; i < count; i++) {
+		cycle.diffs[i].frame = start + i;
+		cycle.diffs[i].diff = diffs[i];
+	}
+}
+
+static void markCycle(Cycle& cycle, int start, int count, char* marks) {
+	cycle.updateFrameMap();
+	for (int i = 0; i < count; i++) {
+		marks[i] = cycle.isSceneChange(start + i) ? 'S' : cycle.isBadFrame(start + i) ? '*' : ' ';
+	}
+}
+
+void classifyCycle(Cycle& cycle, int start, const float* diffs, int count, char* marks) {
+	loadCycle(cycle, start, diffs, count);
+	markCycle(cycle, start, count, marks);
+}
+
+void classifyFrames(AnalysisFile& analysis, CycleFactory factory, int cpuFlags) {
+	const AnalysisHeader& h = analysis.header;
+	const int frames = static_cast<int>(h.frames);
+	const int length = static_cast<int>(h.cycle);
+
+	std::vector<std::unique_ptr<Cycle>> cycles;
+	std::vector<Cycle*> batch;
+	for (int i = 0; i < CLASSIFY_BATCH; i++) {
+		cycles.push_back(factory(length, h.creates, 0, h.sceneThreshold));
+		batch.push_back(cycles.back().get());
+	}
+
+	analysis.marks.assign(frames, ' ');
+	for (int first = 0; first < frames; first += CLASSIFY_BATCH * length) {
+		int count = 0;
+		for (int start = first; start < frames && count < CLASSIFY_BATCH; start += length, count++) {
+			loadCycle(*batch[count], start, &analysis.diffs[start], std::min(length, frames - start));
+		}
+		Cycle::rankBatch(batch.data(), count, cpuFlags);
+		for (int i = 0; i < count; i++) {
+			int start = first + i * length;
+			markCycle(*batch[i], start, std::min(length, frames - start), &analysis.marks[start]);
+		}
+	}
+}
+
+void writeAnalysisFile(const char* path, const AnalysisFile& analysis) {
+	FILE* f = fopen(path, "wb");
+	if (!f) throw std::runtime_error(std::string("Can't create ") + path);
+
+	const size_t frames = analysis.header.frames;
+	bool ok = fwrite(&analysis.header, sizeof(analysis.header), 1, f) == 1 &&
+	          fwrite(analysis.diffs.data(), sizeof(float), frames, f) == frames &&
+	          fwrite(analysis.marks.data(), 1, frames, f) == frames;
+	ok = fclose(f) == 0 && ok;
+	if (!ok) throw std::runtime_error(std::string("Failed to write ") + path);
+}
+
+// Reads and checks the header, leaving f at the diffs. The size of the file is checked against the
+// frames of the header before anything that large is allocated.
+static AnalysisHeader readHeader(FILE* f, const char* path) {
+	AnalysisHeader h;
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, ANALYSIS_FILE_MAGIC, sizeof(h.magic)) != 0)
+		throw std::runtime_error(std::string(path) + " is not a SmoothSkip analysis file");
+
+	long long size = fseek64(f, 0, SEEK_END) == 0 ? ftell64(f) : -1;
+	if (size != static_cast<long long>(sizeof(h)) + static_cast<long long>(h.frames) * static_cast<long long>(sizeof(float) + 1) ||
+	    fseek64(f, sizeof(h), SEEK_SET) != 0)
+		throw std::runtime_error(std::string(path) + " is truncated or doesn't match its header");
+	return h;
+}
+
+AnalysisHeader readAnalysisHeader(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (!f) throw std::runtime_error(std::string("Can't open ") + path);
+	std::unique_ptr<FILE, int(*)(FILE*)> closer(f, fclose);
+	return readHeader(f, path);
+}
+
+AnalysisFile readAnalysisFile(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if (!f) throw std::runtime_error(std::string("Can't open ") + path);
+	std::unique_ptr<FILE, int(*)(FILE*)> closer(f, fclose);
+
+	AnalysisFile analysis;
+	analysis.header = readHeader(f, path);
+
+	const size_t frames = analysis.header.frames;
+	analysis.diffs.resize(frames);
+	analysis.marks.resize(frames);
+	if (fread(analysis.diffs.data(), sizeof(float), frames, f) != frames ||
+	    fread(analysis.marks.data(), 1, frames, f) != frames)
+		throw std::runtime_error(std::string(path) + " is truncated");
+
+	return analysis;
+}
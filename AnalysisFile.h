@@ -0,0 +1,64 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "Cycle.h"
+
+#define ANALYSIS_FILE_MAGIC "SSKIPAN1"
+
+/**
+ * Frame diffs and cycle decisions of a whole clip, written by the analyzer tools and loaded by
+ * the filter's input option instead of computing the diffs itself.
+ *
+ * File layout (little endian): the header, then one float diff per frame (luma difference to
+ * the previous frame, as YDiff computes it), then one mark per frame ('S' scene change, '*' bad
+ * frame that gets a frame inserted before it, ' ' otherwise). Diffs don't depend on the cycle
+ * settings, so a file can be used with other cycle/create/scene values than it was made with.
+ */
+struct AnalysisHeader {
+	char magic[8];          // ANALYSIS_FILE_MAGIC
+	uint32_t frames;
+	uint32_t width;         // luma plane the diffs were computed on
+	uint32_t height;
+	uint32_t bits;
+	uint32_t cycle;         // settings the marks were made with
+	uint32_t creates;
+	float sceneThreshold;
+};
+
+struct AnalysisFile {
+	AnalysisHeader header;
+	std::vector<float> diffs;
+	std::vector<char> marks;
+};
+
+// Marks count frames from frame start on (at most cycle.length) with their diffs, as one cycle.
+void classifyCycle(Cycle& cycle, int start, const float* diffs, int count, char* marks);
+
+// Sets the marks from the diffs, the way the filter would classify each cycle with the cycle,
+// creates and sceneThreshold of the header. The cycles are ranked in batches, with SSE2 if cpuFlags has CPUF_SSE2.
+void classifyFrames(AnalysisFile& analysis, CycleFactory factory, int cpuFlags);
+
+// All throw std::runtime_error on I/O errors or an invalid file.
+void writeAnalysisFile(const char* path, const AnalysisFile& analysis);
+AnalysisFile readAnalysisFile(const char* path);
+// Only the header, for checking that a file fits a clip before reading the diffs.
+AnalysisHeader readAnalysisHeader(const char* path);
@@ -0,0 +1,68 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <map>
+#include <mutex>
+#include <limits>
+#include "AnalysisRegistry.h"
+
+typedef std::pair<const void*, int> AnalysisKey;   // source identity and diff offset
+
+static std::mutex registryMutex;
+static std::map<AnalysisKey, std::weak_ptr<SharedAnalysis>> registry;
+
+SharedAnalysis::SharedAnalysis(std::shared_ptr<const void> source, int frameCount, int offset) :
+	frameCount(frameCount),
+	diffs(new std::atomic<float>[frameCount]),
+	source(std::move(source)),
+	offset(offset)
+{
+	for (int i = 0; i < frameCount; i++) {
+		diffs[i].store(std::numeric_limits<float>::quiet_NaN(), std::memory_order_relaxed);
+	}
+}
+
+bool SharedAnalysis::lookup(int n, float& diff) const {
+	if (n < 0 || n >= frameCount) return false;
+	float d = diffs[n].load(std::memory_order_acquire);
+	if (d != d) return false;   // NaN, not computed yet
+	diff = d;
+	return true;
+}
+
+void SharedAnalysis::store(int n, float diff) {
+	if (n < 0 || n >= frameCount) return;
+	diffs[n].store(diff, std::memory_order_release);
+}
+
+std::shared_ptr<SharedAnalysis> acquireSharedAnalysis(std::shared_ptr<const void> source, int frameCount, int offset) {
+	AnalysisKey key(source.get(), offset);
+	std::lock_guard<std::mutex> lockGuard(registryMutex);
+
+	for (auto it = registry.begin(); it != registry.end();) {   // drop analyses of clips no longer in use
+		if (it->second.expired()) it = registry.erase(it);
+		else ++it;
+	}
+
+	std::shared_ptr<SharedAnalysis> analysis = registry[key].lock();
+	if (!analysis) {
+		analysis = std::make_shared<SharedAnalysis>(std::move(source), frameCount, offset);
+		registry[key] = analysis;
+	}
+	return analysis;
+}
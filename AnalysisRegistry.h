@@ -0,0 +1,47 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/**
+ * Per-frame diffs of one clip for one diff metric, shared by every filter instance
+ * that analyzes the same clip the same way. Entries are written once and read
+ * lock-free, so instances never wait on each other.
+ */
+class SharedAnalysis {
+	int frameCount;
+	std::unique_ptr<std::atomic<float>[]> diffs;   // NaN until computed
+
+public:
+	const std::shared_ptr<const void> source;   // keeps the source, and with it the registry key, alive
+	const int offset;                           // offset of the frame each diff is taken against
+
+	SharedAnalysis(std::shared_ptr<const void> source, int frameCount, int offset);
+
+	// Returns true and sets diff if the diff for frame n has been computed by any instance.
+	bool lookup(int n, float& diff) const;
+	void store(int n, float diff);
+};
+
+// Returns the shared analysis for the source and diff metric, creating it if no other instance holds one.
+// Sources are identified by source.get(), so a host whose handles are copied around (like PClip) passes
+// an aliasing pointer to the underlying clip that owns a handle.
+std::shared_ptr<SharedAnalysis> acquireSharedAnalysis(std::shared_ptr<const void> source, int frameCount, int offset);
@@ -18,19 +18,40 @@
 
 #include <string.h>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include "3rd-party/avs/cpuid.h"
 #include "Cycle.h"
+#include "TopK.h"
 
-float sceneThreshold;
+Cycle::Cycle(int length, int creates, int dupes, float sceneThreshold, CycleDiff* diffs, CycleDiff* sortedDiffs, FrameMap* frameMap) :
+	ranked(0),
+	confidenceRatio(std::numeric_limits<float>::infinity()),
+	creates(creates),
+	dupes(dupes),
+	length(length),
+	sceneThreshold(sceneThreshold),
+	diffs(diffs),
+	sortedDiffs(sortedDiffs),
+	frameMap(frameMap)
+{
+}
 
-int cmpDescendingDiff(const void * a, const void * b);
+DynamicCycle::DynamicCycle(int length, int creates, int dupes, float sceneThreshold) :
+	DynamicCycle(length, creates, dupes, sceneThreshold,
+		std::make_unique<CycleDiff[]>(length),
+		std::make_unique<CycleDiff[]>(length),
+		std::make_unique<FrameMap[]>(length + creates))
+{
+}
 
-Cycle::Cycle(int length, int creates) :
-	length(length),
-	creates(creates),
-	diffs(std::make_unique<CycleDiff[]>(length)),
-	sortedDiffs(std::make_unique<CycleDiff[]>(length)),
-	frameMap(std::make_unique<FrameMap[]>(length + creates)),
-	sorted(false)
+DynamicCycle::DynamicCycle(int length, int creates, int dupes, float sceneThreshold, std::unique_ptr<CycleDiff[]> diffs,
+                           std::unique_ptr<CycleDiff[]> sortedDiffs, std::unique_ptr<FrameMap[]> frameMap) :
+	Cycle(length, creates, dupes, sceneThreshold, diffs.get(), sortedDiffs.get(), frameMap.get()),
+	diffStore(std::move(diffs)),
+	sortedStore(std::move(sortedDiffs)),
+	mapStore(std::move(frameMap))
 {
 	reset();
 }
@@ -42,19 +63,24 @@ void Cycle::reset() {
 		sortedDiffs[i].frame = -1;
 		sortedDiffs[i].diff  = -1;
 	}
-	sorted = false;
+	ranked = 0;
+	confidenceRatio = std::numeric_limits<float>::infinity();
 }
 
 void Cycle::updateFrameMap() {
 	if (diffs[0].frame == -1) return;
 
-	int scaledLength = length + creates;
 	int srcCycleStart = diffs[0].frame;
-	int dstCycleStart = srcCycleStart * scaledLength / length;
+	int dstCycleStart = srcCycleStart * outputLength() / length;
 	int cn;
 
 	for (int i = 0, di = 0; i < length; i++, di++) {
 		cn = diffs[i].frame;
+		if (cn == -1) break;                                   // end of a partial last cycle
+		if (isDupe(cn)) {                                      // dropped, takes no output frame
+			di--;
+			continue;
+		}
 		if (isSceneChange(cn)) {
 			frameMap[di].dstframe = dstCycleStart + di;
 			frameMap[di].srcframe = cn;
@@ -70,6 +96,7 @@ void Cycle::updateFrameMap() {
 		frameMap[di].srcframe = cn;
 		frameMap[di].altclip = false;
 	}
+	updateConfidence();
 }
 
 bool Cycle::includes(int frame) {
@@ -88,7 +115,7 @@ bool Cycle::isBadFrame(int frame) {
 	// 3. A scene change is a frame that would be classified as Bad, but is so bad that it exceeds the schene threshold.
 	// 4. Any frame except a scene frame is judged depending on number of creates required for the cycle (ordered by diffs in descending order).
 	// Thus the top "create" frames with respect to their diff values, exclusing a possible scene change, are considered bad frames in the cycle.
-	sortDiffsIfNeeded();
+	sortDiffsIfNeeded(creates);
 	int sceneSchangesInCycle = hasSceneChange() ? 1 : 0;
 
 	for (int i = sceneSchangesInCycle; i < creates && i < length; i++) {
@@ -100,31 +127,97 @@ bool Cycle::isBadFrame(int frame) {
 }
 
 bool Cycle::isSceneChange(int frame) {
-	sortDiffsIfNeeded();
+	sortDiffsIfNeeded(1);
 	return sortedDiffs[0].frame == frame && hasSceneChange();
 }
 
+bool Cycle::isDupe(int frame) {
+	// The top creates ranks are the scene change and bad frames, and dupes <= length - creates, so a frame
+	// is never both.
+	if (dupes == 0) return false;
+	sortDiffsIfNeeded(length);
+	for (int i = length - dupes; i < length; i++) {
+		if (sortedDiffs[i].frame == frame) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Cycle::updateConfidence() {
+	confidenceRatio = std::numeric_limits<float>::infinity();
+	int count = 0;
+	while (count < length && diffs[count].frame != -1) count++;  // a partial last cycle has fewer frames
+	sortDiffsIfNeeded(std::min(2, length));
+	int top = hasSceneChange() ? 1 : 0;
+	if (count - top < 2) return;
+
+	std::vector<float> values(count);
+	for (int i = 0; i < count; i++) values[i] = diffs[i].diff;
+	std::nth_element(values.begin(), values.begin() + (count - 1) / 2, values.end());
+	float median = values[(count - 1) / 2];
+	float largest = sortedDiffs[top].diff;
+
+	if (largest <= 0) confidenceRatio = 0;
+	else if (median > 0) confidenceRatio = largest / median;
+}
+
+bool Cycle::isStatic(float noiseFloor) {
+	for (int i = 0; i < length && diffs[i].frame != -1; i++) {
+		if (diffs[i].diff >= noiseFloor) return false;
+	}
+	return true;
+}
+
 bool Cycle::hasSceneChange() {
 	return sceneThreshold < sortedDiffs[0].diff;
 }
 
 int Cycle::getFrameWithLargestDiff(int offset) {
-	sortDiffsIfNeeded();
 	if (offset > length - 1) return -1;
+	sortDiffsIfNeeded(offset + 1);
 	return sortedDiffs[offset].frame;
 }
 
-void Cycle::sortDiffsIfNeeded() {
-	if (!sorted) {
-		memcpy(sortedDiffs.get(), diffs.get(), length * sizeof(CycleDiff));
-		qsort(sortedDiffs.get(), length, sizeof(CycleDiff), cmpDescendingDiff);
-		sorted = true;
+void Cycle::sortDiffsIfNeeded(int count) {
+	if (ranked < count) {
+		rank(count);
 	}
 }
 
-int cmpDescendingDiff(const void * a, const void * b) {
-	auto pa = reinterpret_cast<const CycleDiff*>(a);
-	auto pb = reinterpret_cast<const CycleDiff*>(b);
-	double result = static_cast<double>(pa->diff) - static_cast<double>(pb->diff);
-	return result > 0 ? -1 : result < 0 ? 1 : 0;
-}
\ No newline at end of file
+// Only the top entries are ever consulted (the scene change candidate plus "creates" bad frames),
+// so rather than sorting the whole cycle, select the top creates+1 diffs. Cycle lengths covered
+// by the fixed sorting networks are sorted in full, which is cheaper than selecting, as are cycles
+// dropping dupes, which are the bottom entries.
+void DynamicCycle::rank(int count) {
+	int k = std::max(count, std::min(creates + 1, length));
+	memcpy(sortedDiffs, diffs, length * sizeof(CycleDiff));
+	selectTopK(sortedDiffs, length, k);
+	ranked = length <= TOPK_NETWORK_MAX ? length : k;
+}
+
+void Cycle::rankBatch(Cycle* const* cycles, int count, int cpuFlags) {
+	if (count < 1) return;
+
+	std::vector<CycleDiff*> sets;
+	sets.reserve(count);
+
+	for (int i = 0; i < count; i++) {
+		Cycle& c = *cycles[i];
+		if (!(cpuFlags & CPUF_SSE2) || c.length != cycles[0]->length) {
+			c.sortDiffsIfNeeded(c.length);
+			continue;
+		}
+		memcpy(c.sortedDiffs, c.diffs, c.length * sizeof(CycleDiff));
+		sets.push_back(c.sortedDiffs);
+	}
+	if (sets.empty()) return;
+
+	sortTopKBatch(sets.data(), (int)sets.size(), cycles[0]->length);
+
+	for (int i = 0; i < count; i++) {
+		if (cycles[i]->length == cycles[0]->length) {
+			cycles[i]->ranked = cycles[i]->length;
+		}
+	}
+}
@@ -20,8 +20,6 @@
 
 #include <memory>
 
-extern float sceneThreshold;
-
 typedef struct {
 	int frame;      // frame number
 	float diff;     // frame diff to previous
@@ -31,27 +29,80 @@ typedef struct {
 	int dstframe;   // frame number in the resulting clip this filter creates
 	int srcframe;   // frame number in one of the source clips
 	bool altclip;   // the clip ("last" or alt) to pick the frame from
+	bool lowConfidence; // inserted frame of a cycle below the confidence threshold, see CycleEngine::setConfidence
+	bool staticCycle;   // inserted frame of a cycle of static content, see CycleEngine::setStaticFloor
 } FrameMap;
 
+/**
+ * Frame diffs and frame mapping of one cycle. The storage is provided by the subclasses,
+ * DynamicCycle for arbitrary cycle lengths and FixedCycle (FixedCycle.h) for the common ones.
+ */
 class Cycle {
-	bool sorted;
-	void sortDiffsIfNeeded();
+protected:
+	int ranked;         // number of leading sortedDiffs entries known to be in ranking order
+	float confidenceRatio;  // see confidence
+	void sortDiffsIfNeeded(int count);
 	bool hasSceneChange();
+	// Sets confidenceRatio from the diffs, once they are all in place. Part of updateFrameMap.
+	void updateConfidence();
+
+	// Puts at least the top count diffs into ranking order at the start of sortedDiffs, and updates ranked.
+	virtual void rank(int count) = 0;
+
+	Cycle(int length, int creates, int dupes, float sceneThreshold, CycleDiff* diffs, CycleDiff* sortedDiffs, FrameMap* frameMap);
 
 public:
-	int creates;        // number of frames to create in the cycle  (n in m creation)
-	int length;         // cycle length in frames (size of diffs)
+	const int creates;  // number of frames to create in the cycle  (n in m creation)
+	const int dupes;    // number of frames to drop from the cycle, those with the lowest diffs
+	const int length;   // cycle length in frames (size of diffs)
+	const float sceneThreshold; // diffs above this are scene changes
 
-	std::unique_ptr<CycleDiff[]> diffs;         // Array of frame diffs for the current cycle, in frame order
-	std::unique_ptr<CycleDiff[]> sortedDiffs;   // Array of frame diffs for the current cycle, in reverse diff order
-	std::unique_ptr<FrameMap[]> frameMap;       // Clip frame mapping for the current cycle
+	CycleDiff* const diffs;         // Array of frame diffs for the current cycle, in frame order
+	CycleDiff* const sortedDiffs;   // Array of frame diffs for the current cycle, in reverse diff order (top entries only, see sortDiffsIfNeeded)
+	FrameMap* const frameMap;       // Clip frame mapping for the current cycle
 
-	Cycle(int length, int creates);
+	virtual ~Cycle() {}
+
+	// Fully ranks several cycles of equal length in one go, for when a run of consecutive cycles is analyzed
+	// together. Without CPUF_SSE2 in cpuFlags the cycles are ranked one by one.
+	static void rankBatch(Cycle* const* cycles, int count, int cpuFlags);
 
 	int getFrameWithLargestDiff(int offset);
 	bool includes(int frame);
 	bool isBadFrame(int n);
 	bool isSceneChange(int n);
+	// One of the dupes lowest diffs of the cycle, dropped from the output. The missing frames of a partial
+	// last cycle rank lowest, so they are dropped first.
+	bool isDupe(int n);
+	// Output frames of a full cycle.
+	int outputLength() const { return length + creates - dupes; }
+	// Ratio of the largest diff, a scene change aside, to the median diff of the cycle. Near 1 when no frame
+	// stands out. Infinite when there's nothing to compare with: fewer than two frames
+	// besides a scene change, or a zero median below a nonzero largest diff. Computed by updateFrameMap.
+	float confidence() const { return confidenceRatio; }
+	// Whether every diff of the cycle is below noiseFloor, i.e. nothing moves.
+	bool isStatic(float noiseFloor);
 	void reset();
-	void updateFrameMap();
+	virtual void updateFrameMap();
 };
+
+/**
+ * Cycle with heap allocated storage, used for cycle and create values without a FixedCycle specialization.
+ */
+class DynamicCycle : public Cycle {
+	std::unique_ptr<CycleDiff[]> diffStore;
+	std::unique_ptr<CycleDiff[]> sortedStore;
+	std::unique_ptr<FrameMap[]> mapStore;
+
+	DynamicCycle(int length, int creates, int dupes, float sceneThreshold, std::unique_ptr<CycleDiff[]> diffs,
+	             std::unique_ptr<CycleDiff[]> sortedDiffs, std::unique_ptr<FrameMap[]> frameMap);
+
+protected:
+	void rank(int count) override;
+
+public:
+	DynamicCycle(int length, int creates, int dupes, float sceneThreshold);
+};
+
+// Creates the cycles of a clip. See selectCycleFactory in FixedCycle.h.
+typedef std::unique_ptr<Cycle> (*CycleFactory)(int length, int creates, int dupes, float sceneThreshold);
@@ -1,31 +1,142 @@
 #include <stdlib.h>
+#include <algorithm>
+#include <stdexcept>
 #include "Cycle.h"
 #include "CycleCache.h"
 
 using namespace std;
 
-CycleCache::CycleCache(int cycleLength, int createsPerCycle, int clipFrameCount) : 
-	cycleLen(cycleLength), creates(createsPerCycle)
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+CycleCache::CycleCache(int cycleLength, int createsPerCycle, int dupesPerCycle, float sceneThreshold, int clipFrameCount, CycleFactory factory,
+	                   int capacity, bool spillToDisk) :
+	cycleLen(cycleLength), creates(createsPerCycle), dupes(dupesPerCycle), sceneThreshold(sceneThreshold),
+	capacity(capacity), clockHand(0), spillFile(nullptr)
 {
 	// 1. If the final cycle is a partial, account for it by adding an extra cycle in which the partial cycle frames can be stored.
 	// 2. Expand the vector in one go to avoid incremental expansions and memory fragmentations.
-	// 3. Zero-allocate and initialize the vector elements for the entire clip.
+	// 3. Zero-allocate and initialize the vector elements for the entire clip, or for the slots in bounded mode.
 
 	cycleCount = clipFrameCount / cycleLength;
 	if (clipFrameCount % cycleLength != 0) {
 		++cycleCount;
 	}
 
-	cycles.reserve(cycles.capacity() + cycleCount);
+	if (this->capacity >= cycleCount) {
+		this->capacity = 0;                 // the whole clip fits, no point in evicting anything
+	}
+
+	int slots = this->capacity > 0 ? this->capacity : cycleCount;
+	cycles.reserve(cycles.capacity() + slots);
+
+	for (int i = 0; i < slots; i++) {
+		cycles.emplace_back(factory(cycleLen, creates, dupes, sceneThreshold));
+	}
+
+	if (this->capacity > 0) {
+		slotOwner.assign(slots, -1);
+		slotReferenced.assign(slots, false);
+		slotIndex.reserve(slots);
+		if (spillToDisk) {
+			spillFile = tmpfile();          // removed automatically when closed
+		}
+	}
+}
 
-	for (int i = 0; i < cycleCount; i++) {
-		cycles.emplace_back(make_unique<Cycle>(cycleLen, creates));
+CycleCache::~CycleCache() {
+	if (spillFile) {
+		fclose(spillFile);
 	}
 }
 
 Cycle* CycleCache::GetCycleForFrame(int n)
 {
-	int CycleIdx = n / (cycleLen + creates);
-	return cycles.at(CycleIdx).get();
+	int CycleIdx = n / (cycleLen + creates - dupes);
+	if (capacity == 0) {
+		return cycles.at(CycleIdx).get();
+	}
+
+	if (CycleIdx < 0 || CycleIdx >= cycleCount) {
+		throw out_of_range("cycle index out of range");
+	}
+
+	auto it = slotIndex.find(CycleIdx);
+	if (it != slotIndex.end()) {
+		slotReferenced[it->second] = true;
+		return cycles[it->second].get();
+	}
+
+	int slot = evictSlot();
+	Cycle& cycle = *cycles[slot];
+	slotOwner[slot] = CycleIdx;
+	slotReferenced[slot] = true;
+	slotIndex[CycleIdx] = slot;
+	restore(CycleIdx, cycle);
+	return &cycle;
+}
+
+// Clock sweep: skip (and clear) recently referenced slots, take the first one that isn't.
+int CycleCache::evictSlot() {
+	for (;;) {
+		int slot = clockHand;
+		clockHand = (clockHand + 1) % capacity;
+
+		if (slotOwner[slot] == -1) {
+			return slot;
+		}
+		if (slotReferenced[slot]) {
+			slotReferenced[slot] = false;
+			continue;
+		}
+
+		Cycle& cycle = *cycles[slot];
+		spill(slotOwner[slot], cycle);
+		slotIndex.erase(slotOwner[slot]);
+		slotOwner[slot] = -1;
+		cycle.reset();
+		return slot;
+	}
 }
 
+// Spill record layout per cycle: frame count followed by cycleLen diffs. A zero count
+// (unwritten, sparse or past the end of the file) means the cycle was never spilled.
+void CycleCache::spill(int cycleIdx, Cycle& cycle) {
+	if (!spillFile || cycle.diffs[0].frame == -1) return;
+
+	vector<float> record(cycleLen + 1);
+	int count = 0;
+	while (count < cycleLen && cycle.diffs[count].frame != -1) {
+		record[count + 1] = cycle.diffs[count].diff;
+		count++;
+	}
+	record[0] = static_cast<float>(count);
+
+	long long pos = static_cast<long long>(cycleIdx) * record.size() * sizeof(float);
+	if (fseek64(spillFile, pos, SEEK_SET) == 0) {
+		fwrite(record.data(), sizeof(float), record.size(), spillFile);
+	}
+}
+
+void CycleCache::restore(int cycleIdx, Cycle& cycle) {
+	if (!spillFile) return;
+
+	vector<float> record(cycleLen + 1, 0.0f);
+	long long pos = static_cast<long long>(cycleIdx) * record.size() * sizeof(float);
+	fflush(spillFile);
+	if (fseek64(spillFile, pos, SEEK_SET) != 0) return;
+	if (fread(record.data(), sizeof(float), record.size(), spillFile) != record.size()) return;
+
+	int count = static_cast<int>(record[0]);
+	if (count < 1 || count > cycleLen) return;
+
+	int start = cycleIdx * cycleLen;
+	for (int j = 0; j < count; j++) {
+		cycle.diffs[j].frame = start + j;
+		cycle.diffs[j].diff = record[j + 1];
+	}
+	cycle.updateFrameMap();
+}
@@ -18,20 +18,46 @@
 
 #pragma once
 
-#include "cycle.h"
+#include "Cycle.h"
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <stdio.h>
 
 /**
  * Data structure containing all the cycles of the program.
+ *
+ * Unbounded (capacity 0), every cycle of the clip is allocated up front and kept until destruction.
+ * Bounded, a fixed number of cycle slots is recycled using clock (second chance LRU) eviction,
+ * so memory stays constant regardless of clip length. Evicted cycles can optionally be spilled
+ * to a temporary file, so revisiting them restores their diffs instead of recomputing them.
+ *
+ * In bounded mode a returned cycle is only valid until the next call to GetCycleForFrame,
+ * so callers must serialize access and copy out what they need.
  */
 class CycleCache {
 	int cycleCount;
 	int cycleLen;
 	int creates;
+	int dupes;
+	float sceneThreshold;
 	std::vector<std::unique_ptr<Cycle>> cycles;
 
+	// Bounded mode state
+	int capacity;                             // max cycles in memory, 0 for unbounded
+	std::vector<int> slotOwner;               // cycle index held by each slot, -1 if free
+	std::vector<bool> slotReferenced;         // clock reference bits
+	std::unordered_map<int, int> slotIndex;   // cycle index -> slot
+	int clockHand;
+	FILE* spillFile;                          // evicted cycles' diffs, null if spilling is disabled
+
+	int evictSlot();
+	void spill(int cycleIdx, Cycle& cycle);
+	void restore(int cycleIdx, Cycle& cycle);
+
 public:
-	CycleCache(int cycleLength, int createsPerCycle, int clipFrameCount);
-	Cycle* CycleCache::GetCycleForFrame(int n);
+	CycleCache(int cycleLength, int createsPerCycle, int dupesPerCycle, float sceneThreshold, int clipFrameCount, CycleFactory factory,
+	           int capacity = 0, bool spillToDisk = false);
+	~CycleCache();
+	Cycle* GetCycleForFrame(int n);
 };
@@ -0,0 +1,139 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <algorithm>
+#include "CycleEngine.h"
+
+CycleEngine::CycleEngine(int sourceFrames, int cycleLen, int creates, int dupes, float sceneThreshold, CycleFactory factory,
+                         int cpuFlags, int cacheCycles, bool spill) :
+	cycles(cycleLen, creates, dupes, sceneThreshold, sourceFrames, factory, cacheCycles, spill),
+	sourceFrames(sourceFrames),
+	counters(nullptr),
+	trace(nullptr),
+	hints(nullptr),
+	confidenceThreshold(0),
+	staticFloor(0),
+	length(cycleLen),
+	creates(creates),
+	dupes(dupes),
+	diffs(cpuFlags)
+{
+}
+
+void CycleEngine::setCounters(PerfCounters* perfCounters) {
+	counters = perfCounters;
+	diffs.setCounters(perfCounters);
+}
+
+void CycleEngine::setTrace(TraceRecorder* traceRecorder) {
+	trace = traceRecorder;
+	diffs.setTrace(traceRecorder);
+}
+
+void CycleEngine::setHints(EncoderHints* encoderHints) {
+	hints = encoderHints;
+}
+
+void CycleEngine::setConfidence(float threshold) {
+	confidenceThreshold = threshold;
+}
+
+void CycleEngine::setStaticFloor(float noiseFloor) {
+	staticFloor = noiseFloor;
+}
+
+int CycleEngine::outputFrameCount() const {
+	int newFrames = (sourceFrames / length) * (creates - dupes);
+	int rest = sourceFrames % length;
+	if (rest > 0) {
+		newFrames += std::min(rest, creates);                    // a non-full last cycle will still introduce a new frame.
+		newFrames -= std::max(dupes - (length - rest), 0);       // its missing frames are the first dupes dropped, see Cycle::isDupe
+	}
+	return sourceFrames + newFrames;
+}
+
+int CycleEngine::cycleEnd(int n) const {
+	return std::min(cycleStart(n) + length, sourceFrames) - 1;
+}
+
+bool CycleEngine::isAnalyzed(int n) {
+	return cycles.GetCycleForFrame(n)->includes(cycleStart(n));
+}
+
+void CycleEngine::cycleDiffs(FrameSource& source, int n, float* out) const {
+	const int start = cycleStart(n);
+	const int count = cycleEnd(n) - start + 1;
+
+	// Quick diffs tell at a fraction of the cost whether anything in the cycle moves, and if nothing does,
+	// they are its diffs. Only well below the floor though, to leave room for changes in the rows they skip.
+	// Otherwise all diffs are computed in full, so that the cycle is ranked on one scale. Either way only
+	// the cycle's own frames decide, so the diffs don't depend on the order cycles are analyzed in.
+	if (staticFloor > 0) {
+		bool still = true;
+		for (int j = 0; j < count && still; j++) {
+			out[j] = diffs.quickDiffFromPrevious(source, start + j);
+			still = out[j] < staticFloor / 2;
+		}
+		if (still) return;
+	}
+	for (int j = 0; j < count; j++) {
+		out[j] = diffs.diffFromPrevious(source, start + j);
+	}
+}
+
+void CycleEngine::analyze(int n, const float* frameDiffs) {
+	Cycle& cycle = *cycles.GetCycleForFrame(n);
+	int start = cycleStart(n);
+
+	cycle.reset();
+	for (int i = start, j = 0; i <= cycleEnd(n); i++, j++) {
+		cycle.diffs[j].frame = i;
+		cycle.diffs[j].diff = frameDiffs[j];
+	}
+	cycle.updateFrameMap();
+	if (hints) hints->addCycle(cycle);
+	if (counters) counters->add(PERF_CYCLES);
+}
+
+void CycleEngine::analyze(FrameSource& source, int n) {
+	TraceSpan span(trace, TRACE_ANALYZE, cycleStart(n));
+	std::vector<float> frameDiffs(length);
+	cycleDiffs(source, n, frameDiffs.data());
+	analyze(n, frameDiffs.data());
+}
+
+FrameMap CycleEngine::mapping(int n, CycleSnapshot* snapshot) {
+	Cycle& cycle = *cycles.GetCycleForFrame(n);
+
+	if (snapshot) {
+		snapshot->sceneThreshold = cycle.sceneThreshold;
+		snapshot->confidence = cycle.confidence();
+		snapshot->diffs.assign(cycle.diffs, cycle.diffs + cycle.length);
+		snapshot->marks.resize(cycle.length);
+		for (int i = 0; i < cycle.length; i++) {
+			int cn = cycle.diffs[i].frame;
+			snapshot->marks[i] = cycle.isSceneChange(cn) ? 'S' : cycle.isBadFrame(cn) ? '*' : cycle.isDupe(cn) ? 'D' : ' ';
+		}
+	}
+
+	FrameMap map = cycle.frameMap[n % (length + creates - dupes)];
+	map.lowConfidence = map.altclip && confidenceThreshold > 0 && cycle.confidence() < confidenceThreshold;
+	map.staticCycle = map.altclip && staticFloor > 0 && cycle.isStatic(staticFloor);
+	return map;
+}
@@ -0,0 +1,94 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <vector>
+#include "Cycle.h"
+#include "CycleCache.h"
+#include "DiffEngine.h"
+#include "EncoderHints.h"
+#include "FrameSource.h"
+#include "PerfCounters.h"
+#include "Trace.h"
+
+// Copy of a cycle's diffs and their classification, for use outside the cycle lock.
+struct CycleSnapshot {
+	float sceneThreshold;
+	float confidence;          // Cycle::confidence
+	std::vector<CycleDiff> diffs;
+	std::vector<char> marks;   // 'S' scene change, '*' bad frame, 'D' dropped dupe, ' ' otherwise
+};
+
+/**
+ * The cycle decisions of a clip: which source clip frame each output frame is, and whether it is
+ * taken from the alt clip. Cycles are analyzed on demand, with the diffs of a DiffEngine. Output
+ * frame numbers are those of the whole clip, (length + creates - dupes) frames per full cycle.
+ *
+ * Like the CycleCache it keeps the cycles in, the engine isn't synchronized. Callers serialize
+ * access, and copy out the mapping and snapshot before releasing their lock. Only cycleDiffs
+ * may run concurrently with the rest, so hosts that fetch frames asynchronously can compute the
+ * diffs of a cycle outside their lock and analyze it with them.
+ */
+class CycleEngine {
+	CycleCache cycles;
+	int sourceFrames;
+	PerfCounters* counters;
+	TraceRecorder* trace;
+	EncoderHints* hints;
+	float confidenceThreshold;
+	float staticFloor;
+
+public:
+	const int length;    // cycle length in source frames
+	const int creates;   // frames created per cycle
+	const int dupes;     // frames dropped per cycle
+	DiffEngine diffs;
+
+	CycleEngine(int sourceFrames, int cycleLen, int creates, int dupes, float sceneThreshold, CycleFactory factory, int cpuFlags,
+	            int cacheCycles = 0, bool spill = false);
+
+	// Counts the cycles analyzed and, through diffs, the diffs computed. Null to not count.
+	void setCounters(PerfCounters* perfCounters);
+	// Traces the cycles analyzed from a FrameSource and, through diffs, the diffs computed. Null to not trace.
+	void setTrace(TraceRecorder* traceRecorder);
+	// Adds every cycle analyzed to the encoder hints. Null to not write hints.
+	void setHints(EncoderHints* encoderHints);
+	// Inserted frames of cycles whose Cycle::confidence is below threshold get FrameMap::lowConfidence set,
+	// for the caller to make them cheaply rather than render them. 0, the default, never sets it.
+	void setConfidence(float threshold);
+	// Inserted frames of cycles whose diffs are all below noiseFloor get FrameMap::staticCycle set, for the
+	// caller to repeat a source frame rather than make them. Each cycle is first checked with
+	// DiffEngine::quickDiffFromPrevious, see cycleDiffs. 0, the default, never sets it.
+	void setStaticFloor(float noiseFloor);
+
+	int outputFrameCount() const;
+	// First and last source frame of the cycle output frame n belongs to.
+	int cycleStart(int n) const { return n / (length + creates - dupes) * length; }
+	int cycleEnd(int n) const;
+
+	bool isAnalyzed(int n);
+	// Diffs of the source frames of output frame n's cycle, cycleEnd - cycleStart + 1 of them.
+	void cycleDiffs(FrameSource& source, int n, float* diffs) const;
+	void analyze(int n, const float* diffs);
+	void analyze(FrameSource& source, int n);
+
+	// Mapping of output frame n, whose cycle must have been analyzed.
+	FrameMap mapping(int n, CycleSnapshot* snapshot = nullptr);
+};
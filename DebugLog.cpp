@@ -0,0 +1,77 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <stdexcept>
+#include "DebugLog.h"
+
+DebugLog::DebugLog(const std::string& path, int cycleLength) :
+	file(fopen(path.c_str(), "w")),
+	done(false)
+{
+	if (!file) throw std::runtime_error("Can't create debug log " + path);
+	fprintf(file, "frame,source,using,confidence");
+	for (int i = 1; i <= cycleLength; i++) {
+		fprintf(file, ",mark%d,frame%d,diff%d", i, i, i);
+	}
+	fputc('\n', file);
+	writer = std::thread(&DebugLog::run, this);
+}
+
+DebugLog::~DebugLog() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+	}
+	ready.notify_one();
+	writer.join();
+	fclose(file);
+}
+
+void DebugLog::add(int frame, int source, const char* clip, CycleSnapshot&& cycle) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back({ frame, source, clip, std::move(cycle) });
+	}
+	ready.notify_one();
+}
+
+void DebugLog::run() {
+	std::vector<Record> batch;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		ready.wait(lock, [this] { return done || !queue.empty(); });
+		if (queue.empty()) break;                  // done, and everything written
+		batch.swap(queue);
+		lock.unlock();
+		for (const Record& record : batch) {
+			write(record);
+		}
+		batch.clear();
+		fflush(file);
+		lock.lock();
+	}
+}
+
+void DebugLog::write(const Record& r) {
+	fprintf(file, "%d,%d,%s,%.4f", r.frame, r.source, r.clip, r.cycle.confidence);
+	for (size_t i = 0; i < r.cycle.diffs.size(); i++) {
+		fprintf(file, ",%c,%d,%.5f", r.cycle.marks[i] == ' ' ? '-' : r.cycle.marks[i], r.cycle.diffs[i].frame, r.cycle.diffs[i].diff);
+	}
+	fputc('\n', file);
+}
@@ -0,0 +1,70 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CycleEngine.h"
+
+/**
+ * The information of the debug overlay as CSV records, one per output frame, for leaving
+ * diagnostics on without touching the output frames.
+ *
+ * Columns: frame, the output frame; source, the frame of the clip it's taken from; using, "A" for
+ * the source clip, "B" for the alt clip, "blend", "motion" or "static" for inserted frames made by
+ * the filter; confidence, that of the cycle; then mark, frame and diff of each frame of the cycle,
+ * with the marks of CycleSnapshot ('-' for ' '). Records are in the order frames are served.
+ *
+ * Frame threads only queue records; a background thread formats and writes them, and flushes the
+ * file whenever it has caught up. Records still queued are written on destruction.
+ */
+class DebugLog {
+	struct Record {
+		int frame;
+		int source;
+		const char* clip;
+		CycleSnapshot cycle;
+	};
+
+	FILE* file;
+	std::mutex mutex;                 // guards queue and done
+	std::condition_variable ready;
+	std::vector<Record> queue;
+	bool done;
+	std::thread writer;
+
+	void run();
+	void write(const Record& record);
+
+public:
+	// Overwrites the file with the header of a cycle of cycleLength frames. Throws std::runtime_error
+	// if it can't be created.
+	DebugLog(const std::string& path, int cycleLength);
+	~DebugLog();
+	DebugLog(const DebugLog&) = delete;
+	DebugLog& operator=(const DebugLog&) = delete;
+
+	// clip must be a string literal, see the using column.
+	void add(int frame, int source, const char* clip, CycleSnapshot&& cycle);
+};
@@ -0,0 +1,89 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <algorithm>
+#include "DiffEngine.h"
+
+DiffEngine::DiffEngine(int cpuFlags) : cpuFlags(cpuFlags), counters(nullptr), trace(nullptr) {
+}
+
+void DiffEngine::usePrecomputed(std::vector<float> diffs) {
+	precomputed = std::move(diffs);
+}
+
+void DiffEngine::useShared(std::shared_ptr<SharedAnalysis> analysis) {
+	shared = std::move(analysis);
+}
+
+void DiffEngine::setCounters(PerfCounters* perfCounters) {
+	counters = perfCounters;
+}
+
+void DiffEngine::setTrace(TraceRecorder* traceRecorder) {
+	trace = traceRecorder;
+}
+
+float DiffEngine::diffFromPrevious(FrameSource& source, int n) const {
+	float diff;
+	if (!precomputed.empty()) {
+		return precomputed[n];
+	}
+	if (shared && shared->lookup(n, diff)) {   // another instance on the same source may already have computed it
+		return diff;
+	}
+
+	PerfTimer timer(counters, PERF_DIFFS, PERF_DIFF_NS);
+	TraceSpan span(trace, TRACE_DIFF, n);
+	int last = source.frameCount() - 1;
+	n = std::min(std::max(n, 0), last);
+	int prev = std::min(std::max(n - 1, 0), last);
+	PlaneKernel kernel;
+	diff = planeDiff(source.luma(n), source.luma(prev), cpuFlags, &kernel);
+	if (counters) counters->add(static_cast<PerfCounter>(PERF_KERNEL_C + kernel));
+
+	if (shared) shared->store(n, diff);
+	return diff;
+}
+
+float DiffEngine::quickDiffFromPrevious(FrameSource& source, int n) const {
+	if (!precomputed.empty()) {
+		return precomputed[n];
+	}
+
+	PerfTimer timer(counters, PERF_DIFFS, PERF_DIFF_NS);
+	TraceSpan span(trace, TRACE_DIFF, n);
+	int last = source.frameCount() - 1;
+	n = std::min(std::max(n, 0), last);
+	int prev = std::min(std::max(n - 1, 0), last);
+	PlaneView a = source.luma(n), b = source.luma(prev);
+	a.pitch *= DIFF_QUICK_ROW_STEP;                             // the kernels step over the rows in between
+	b.pitch *= DIFF_QUICK_ROW_STEP;
+	a.height = (a.height + DIFF_QUICK_ROW_STEP - 1) / DIFF_QUICK_ROW_STEP;
+	PlaneKernel kernel;
+	float diff = planeDiff(a, b, cpuFlags, &kernel);
+	if (counters) {
+		counters->add(PERF_QUICK_DIFFS);
+		counters->add(static_cast<PerfCounter>(PERF_KERNEL_C + kernel));
+	}
+	return diff;
+}
+
+float DiffEngine::planeDiff(const PlaneView& a, const PlaneView& b, int cpuFlags, PlaneKernel* kernel) {
+	return PlaneDiff(a.data, b.data, a.pitch, b.pitch, a.rowSize, a.height, a.pixelSize, a.bits, cpuFlags, kernel);
+}
@@ -0,0 +1,67 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "AnalysisRegistry.h"
+#include "FrameSource.h"
+#include "PerfCounters.h"
+#include "PlaneDiff.h"
+#include "Trace.h"
+
+// Every this many rows are compared for a quick diff.
+#define DIFF_QUICK_ROW_STEP 4
+
+/**
+ * Luma difference of each frame to its predecessor, the metric cycles are ranked by. The first
+ * frame is compared to itself, so its diff is 0.
+ *
+ * Diffs come from, in order of preference: diffs computed up front (e.g. an analysis file),
+ * the analysis shared with other instances on the same source, or the frame source itself.
+ * Safe to call from several threads once set up.
+ */
+class DiffEngine {
+	int cpuFlags;
+	std::vector<float> precomputed;
+	std::shared_ptr<SharedAnalysis> shared;
+	PerfCounters* counters;
+	TraceRecorder* trace;
+
+public:
+	// cpuFlags are CPUF_* flags from avs/cpuid.h, see DetectCPUFlags.
+	explicit DiffEngine(int cpuFlags);
+
+	void usePrecomputed(std::vector<float> diffs);
+	void useShared(std::shared_ptr<SharedAnalysis> analysis);
+	// Counts the diffs computed, their time and kernels. Null to not count.
+	void setCounters(PerfCounters* perfCounters);
+	// Records a TRACE_DIFF event per diff computed. Null to not trace.
+	void setTrace(TraceRecorder* traceRecorder);
+
+	float diffFromPrevious(FrameSource& source, int n) const;
+	// Estimate of diffFromPrevious from every DIFF_QUICK_ROW_STEP'th row, for telling cheaply whether anything
+	// moves. Exact with diffs computed up front. Neither shared with nor taken from other instances, so the
+	// estimate of a frame is always the same.
+	float quickDiffFromPrevious(FrameSource& source, int n) const;
+
+	// Mean absolute difference per pixel of two planes of the same size and format.
+	static float planeDiff(const PlaneView& a, const PlaneView& b, int cpuFlags, PlaneKernel* kernel = nullptr);
+};
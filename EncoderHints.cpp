@@ -0,0 +1,128 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <stdexcept>
+#include "EncoderHints.h"
+
+// Null for no path.
+static FILE* createFile(const std::string& path, const char* name) {
+	if (path.empty()) return nullptr;
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) throw std::runtime_error(std::string("Can't create ") + name + " " + path);
+	return f;
+}
+
+EncoderHints::EncoderHints(const std::string& qpfilePath, const std::string& zonesPath, const std::string& zoneOptions,
+                           const std::string& timecodesPath, double frameMs, int length, int firstCycle, int lastCycle) :
+	qpfile(nullptr),
+	zones(nullptr),
+	timecodes(nullptr),
+	zoneOptions(zoneOptions),
+	timecodesPath(timecodesPath),
+	frameMs(frameMs),
+	length(length),
+	firstCycle(firstCycle),
+	lastCycle(lastCycle),
+	nextCycle(firstCycle),
+	zonesWritten(false)
+{
+	try {
+		qpfile = createFile(qpfilePath, "qpfile");
+		zones = createFile(zonesPath, "zones file");
+		timecodes = createFile(timecodesPath, "timecodes file");
+	}
+	catch (std::runtime_error&) {
+		if (qpfile) fclose(qpfile);
+		if (zones) fclose(zones);
+		throw;
+	}
+	if (timecodes) fprintf(timecodes, "# timecode format v2\n");
+}
+
+EncoderHints::~EncoderHints() {
+	if (timecodes && nextCycle <= lastCycle) {   // a short timecodes file would silently shift every frame after the gap
+		fclose(timecodes);
+		timecodes = nullptr;
+		remove(timecodesPath.c_str());
+		fprintf(stderr, "[SmoothSkip] Removed the timecodes file %s, as the frames from source frame %d on were never served\n",
+			timecodesPath.c_str(), nextCycle * length);
+	}
+	for (auto& cycle : pending) {                // cycles after a gap of frames that were never served
+		write(cycle.second);
+	}
+	if (qpfile) fclose(qpfile);
+	if (zones) {
+		fputc('\n', zones);
+		fclose(zones);
+	}
+	if (timecodes) fclose(timecodes);
+}
+
+void EncoderHints::addCycle(Cycle& cycle) {
+	const int index = cycle.diffs[0].frame / length;
+	if (index < nextCycle || pending.count(index)) return;
+
+	// Output frames the way Cycle::updateFrameMap lays them out: one entry per source frame, preceded by
+	// another one for a scene change or a bad frame, and none for a dupe.
+	int entries = 0;
+	for (int i = 0; i < length && cycle.diffs[i].frame != -1; i++) {
+		int cn = cycle.diffs[i].frame;
+		entries += cycle.isDupe(cn) ? 0 : cycle.isSceneChange(cn) || cycle.isBadFrame(cn) ? 2 : 1;
+	}
+
+	std::vector<Frame> frames;
+	const int firstOutput = firstCycle * cycle.outputLength(), firstSource = firstCycle * length;
+	for (int di = 0; di < entries; di++) {
+		const FrameMap& map = cycle.frameMap[di];
+		const FrameMap* prev = di ? &cycle.frameMap[di - 1] : nullptr;
+		bool shown = !map.altclip && (!prev || prev->altclip || prev->srcframe != map.srcframe);  // first output of the source frame
+		bool cut = shown && cycle.isSceneChange(map.srcframe);
+		if (timecodes) {
+			if (shown) frames.push_back({ map.srcframe - firstSource, cut, false, (map.dstframe - firstOutput) * frameMs });
+		} else if (cut || map.altclip) {
+			frames.push_back({ map.dstframe - firstOutput, cut, map.altclip, 0 });
+		}
+	}
+
+	if (index != nextCycle) {
+		pending[index] = std::move(frames);
+		return;
+	}
+	write(frames);
+	nextCycle++;
+	for (auto it = pending.begin(); it != pending.end() && it->first == nextCycle; it = pending.erase(it)) {
+		write(it->second);
+		nextCycle++;
+	}
+}
+
+void EncoderHints::write(const std::vector<Frame>& frames) {
+	for (const Frame& f : frames) {
+		if (f.frame < 0) continue;
+		if (qpfile && f.cut) fprintf(qpfile, "%d K\n", f.frame);
+		if (zones && f.inserted) {
+			fprintf(zones, "%s%d,%d,%s", zonesWritten ? "/" : "", f.frame, f.frame, zoneOptions.c_str());
+			zonesWritten = true;
+		}
+		if (timecodes) fprintf(timecodes, "%.6f\n", f.time);
+	}
+	if (qpfile) fflush(qpfile);              // readable while the clip is still being served
+	if (zones) fflush(zones);
+	if (timecodes) fflush(timecodes);
+}
@@ -0,0 +1,79 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Cycle.h"
+
+/**
+ * Hint files for x264/x265 written while the clip is served, from what the cycle analysis already
+ * knows: a qpfile forcing a keyframe at every scene change, and a --zones string with a zone per
+ * inserted frame. The encoder can then make do with lighter scenecut and lookahead settings.
+ *
+ * With a timecodes file the output is retimed instead (mode="timecodes"): it is the source frames
+ * themselves, and the v2 timecodes give each one the time it has in the output with frames inserted.
+ * The frame before an inserted one is held for its slot too, a scene change frame for its repeat.
+ *
+ * Cycles are written in output order, each once, as soon as the cycles before them have been written.
+ * Cycles analyzed ahead are held back until then, or until the hints are destroyed. Frame numbers are
+ * those of the filter's output, starting with cycle firstCycle. The qpfile and zones of cycles after
+ * a gap of cycles never served are still written on destruction, as their frame numbers are absolute.
+ * Timecodes aren't: a timecodes file missing any cycle up to lastCycle is removed, and the gap reported
+ * on stderr. Not synchronized: add cycles under the lock the CycleEngine is used with.
+ */
+class EncoderHints {
+	struct Frame {
+		int frame;      // in the output
+		bool cut;       // first output frame of a scene change
+		bool inserted;
+		double time;    // ms, of retimed output
+	};
+
+	FILE* qpfile;
+	FILE* zones;
+	FILE* timecodes;
+	std::string zoneOptions;
+	std::string timecodesPath;
+	const double frameMs;
+	const int length;
+	const int firstCycle;
+	const int lastCycle;
+	int nextCycle;                            // index of the next cycle to write
+	bool zonesWritten;                        // whether the zones string has a zone, to separate the next one
+	std::map<int, std::vector<Frame>> pending;   // cycles analyzed ahead of nextCycle, by index
+
+	void write(const std::vector<Frame>& frames);
+
+public:
+	// Any path may be empty to not write that file. frameMs is the duration of an output frame with frames
+	// inserted, for the timecodes. Cycles firstCycle to lastCycle are output. Throws std::runtime_error if a
+	// file can't be created.
+	EncoderHints(const std::string& qpfilePath, const std::string& zonesPath, const std::string& zoneOptions,
+	             const std::string& timecodesPath, double frameMs, int length, int firstCycle, int lastCycle);
+	~EncoderHints();
+	EncoderHints(const EncoderHints&) = delete;
+	EncoderHints& operator=(const EncoderHints&) = delete;
+
+	// The hints of an analyzed cycle. Cycles already added, e.g. ones analyzed again after eviction, are ignored.
+	void addCycle(Cycle& cycle);
+};
@@ -0,0 +1,114 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string.h>
+#include "Cycle.h"
+#include "TopK.h"
+
+/**
+ * Cycle with inline storage and the cycle/create values known at compile time, so that
+ * ranking and classification compile down to straight-line code.
+ */
+template<int Length, int Creates>
+class FixedCycle : public Cycle {
+	static_assert(Creates >= 1 && Creates <= Length, "1 <= Creates <= Length");
+	static_assert(Length <= TOPK_NETWORK_MAX, "Length must be covered by the sorting networks");
+
+	std::array<CycleDiff, Length> diffStore;
+	std::array<CycleDiff, Length> sortedStore;
+	std::array<FrameMap, Length + Creates> mapStore;
+
+protected:
+	void rank(int) override {
+		sortedStore = diffStore;
+		sortNetwork<Length>(sortedStore.data());
+		ranked = Length;
+	}
+
+public:
+	explicit FixedCycle(float sceneThreshold) : Cycle(Length, Creates, 0, sceneThreshold, diffStore.data(), sortedStore.data(), mapStore.data()) {
+		reset();
+	}
+
+	// Same classification as Cycle::updateFrameMap, with all loop bounds constant.
+	void updateFrameMap() override {
+		if (diffStore[0].frame == -1) return;
+
+		sortDiffsIfNeeded(Length);
+		const bool scene = hasSceneChange();
+		const int sceneFrame = scene ? sortedStore[0].frame : -2;
+		const int firstBad = scene ? 1 : 0;
+
+		bool bad[Length];
+		for (int i = 0; i < Length; i++) {
+			bool b = false;
+			for (int k = 0; k < Creates; k++) {
+				b |= k >= firstBad && sortedStore[k].frame == diffStore[i].frame;
+			}
+			bad[i] = b;
+		}
+
+		const int srcCycleStart = diffStore[0].frame;
+		const int dstCycleStart = srcCycleStart * (Length + Creates) / Length;
+
+		for (int i = 0, di = 0; i < Length; i++, di++) {
+			const int cn = diffStore[i].frame;
+			if (cn == -1) break;
+			if (cn == sceneFrame || bad[i]) {
+				mapStore[di].dstframe = dstCycleStart + di;
+				mapStore[di].srcframe = cn;
+				mapStore[di].altclip = cn != sceneFrame;
+				di++;
+			}
+			mapStore[di].dstframe = dstCycleStart + di;
+			mapStore[di].srcframe = cn;
+			mapStore[di].altclip = false;
+		}
+		updateConfidence();
+	}
+};
+
+template<int Length, int Creates>
+std::unique_ptr<Cycle> makeFixedCycle(int, int, int, float sceneThreshold) {
+	return std::unique_ptr<Cycle>(new FixedCycle<Length, Creates>(sceneThreshold));
+}
+
+inline std::unique_ptr<Cycle> makeDynamicCycle(int length, int creates, int dupes, float sceneThreshold) {
+	return std::unique_ptr<Cycle>(new DynamicCycle(length, creates, dupes, sceneThreshold));
+}
+
+// Picks the cycle implementation for the cycle/create pair. The common pairs get
+// a FixedCycle specialization, everything else, and cycles dropping dupes, falls back to DynamicCycle.
+inline CycleFactory selectCycleFactory(int length, int creates, int dupes = 0) {
+	if (dupes > 0) return makeDynamicCycle;
+	switch (length * 100 + creates) {
+	case  401: return makeFixedCycle<4, 1>;
+	case  402: return makeFixedCycle<4, 2>;
+	case  501: return makeFixedCycle<5, 1>;
+	case  502: return makeFixedCycle<5, 2>;
+	case  601: return makeFixedCycle<6, 1>;
+	case  602: return makeFixedCycle<6, 2>;
+	case 1001: return makeFixedCycle<10, 1>;
+	case 1002: return makeFixedCycle<10, 2>;
+	}
+	return makeDynamicCycle;
+}
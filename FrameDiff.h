@@ -1,5 +1,46 @@
 #pragma once
+#include <list>
+#include <memory>
+#include <mutex>
 #include "3rd-party/avisynth.h"
+#include "AnalysisRegistry.h"
+#include "FrameSource.h"
+
+// Frames of an AviSynth clip for the host independent analysis. The script environment is per
+// call in an MT runtime, so a source is made for each GetFrame call rather than kept.
+class ClipFrameSource : public FrameSource {
+	PClip clip;
+	IScriptEnvironment* env;
+	VideoInfo vi;
+
+public:
+	ClipFrameSource(PClip clip, IScriptEnvironment* env);
+	int frameCount() override;
+	PlaneView luma(int n) override;
+};
+
+// Bytes per component of the clip's pixels, 1, 2 or 4, and the bits used of them, 32 for float.
+int ComponentSize(VideoInfo& vi);
+int BitsPerComponent(VideoInfo& vi);
 
 // Returns the difference between frame n and the frame at the provided offset from n.
-float YDiff(AVSValue clip, int n, int offset, IScriptEnvironment* env);
\ No newline at end of file
+float YDiff(AVSValue clip, int n, int offset, IScriptEnvironment* env);
+
+// Clips whose diffs SmoothSkipYDiff keeps. Runtime scripts may make a new clip per frame, so only the
+// most recently used ones are kept, each holding on to its clip and a diff per frame.
+#define SCRIPT_DIFFS_CLIPS 8
+
+// Diffs computed by the SmoothSkipYDiff script function, memoized per clip and offset in the same
+// shared analyses the filter uses. A runtime function has no instance to hold them, so they're kept
+// here, for the SCRIPT_DIFFS_CLIPS clip and offset pairs used last.
+class ScriptDiffs {
+	typedef std::pair<std::pair<const IClip*, int>, std::shared_ptr<SharedAnalysis>> Entry;
+	std::mutex mutex;
+	std::list<Entry> analyses;   // most recently used first; each analysis holds its clip, so the keys stay unique
+
+public:
+	std::shared_ptr<SharedAnalysis> acquire(PClip clip, int offset);
+};
+
+AVSValue __cdecl Create_SmoothSkipYDiff(AVSValue args, void* user_data, IScriptEnvironment* env);
+void __cdecl Free_ScriptDiffs(void* user_data, IScriptEnvironment* env);
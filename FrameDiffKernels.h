@@ -0,0 +1,50 @@
+// Sum of absolute differences kernels used by PlaneSAD (PlaneDiff.cpp).
+//
+// Each instruction set lives in its own compilation unit (FrameDiff_<isa>.cpp), so the units can
+// be built with the compiler flags for their instruction set while the rest of the plugin is built
+// for the baseline. The dispatcher, PlaneSAD in PlaneDiff.cpp, picks a kernel based on the runtime CPU flags.
+//
+// Code extracted from avisynth+ conditional_functions.cpp, Copyright 2002 Ben Rudiak-Gould et al.
+// Under GNU GPL, same license as that of this program.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstdlib>
+#include <type_traits>
+#include "3rd-party/avs/config.h"
+#include "3rd-party/avs/types.h"
+
+// C reference kernel for 8 and 16 bit integer and float pixels. No alignment or size requirements.
+template<typename pixel_t>
+double get_sad_c(const BYTE* c_plane8, const BYTE* t_plane8, size_t height, size_t width, size_t c_pitch, size_t t_pitch) {
+	const pixel_t *c_plane = reinterpret_cast<const pixel_t *>(c_plane8);
+	const pixel_t *t_plane = reinterpret_cast<const pixel_t *>(t_plane8);
+	c_pitch /= sizeof(pixel_t);
+	t_pitch /= sizeof(pixel_t);
+	typedef typename std::conditional < sizeof(pixel_t) == 4, double, __int64>::type sum_t;
+	sum_t accum = 0; // int32 holds sum of maximum 16 Mpixels for 8 bit, and 65536 pixels for uint16_t pixels
+
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			accum += std::abs(t_plane[x] - c_plane[x]);
+		}
+		c_plane += c_pitch;
+		t_plane += t_pitch;
+	}
+	return (double)accum;
+}
+
+// MMX/ISSE kernel for 8 bit pixels. 32 bit x86 only, since x64 compilers dropped MMX intrinsics.
+// The sum must fit in 32 bits.
+#ifdef X86_32
+size_t get_sad_isse(const BYTE* src_ptr, const BYTE* other_ptr, size_t height, size_t width, size_t src_pitch, size_t other_pitch);
+#endif
+
+// SSE2 kernel for 8 and 16 bit pixels, rowsize >= 16. With aligned, both planes and pitches must be
+// 16 byte aligned, otherwise unaligned loads are used and there are no alignment requirements.
+// A row sum must fit in an int, which holds for rows up to 32767 16 bit pixels.
+// Instantiated for uint8_t and uint16_t, packedRGB3264 false, both aligned variants.
+template<typename pixel_t, bool packedRGB3264, bool aligned = true>
+__int64 calculate_sad_8_or_16_sse2(const BYTE* cur_ptr, const BYTE* other_ptr, int cur_pitch, int other_pitch, size_t rowsize, size_t height);
@@ -0,0 +1,36 @@
+// MMX/ISSE SAD kernel, see FrameDiffKernels.h
+//
+// Code extracted from avisynth+ conditional_functions.cpp, Copyright 2002 Ben Rudiak-Gould et al.
+// Under GNU GPL, same license as that of this program.
+
+#include "FrameDiffKernels.h"
+
+#ifdef X86_32
+#include <xmmintrin.h>
+#include <cstdlib>
+
+size_t get_sad_isse(const BYTE* src_ptr, const BYTE* other_ptr, size_t height, size_t width, size_t src_pitch, size_t other_pitch) {
+	size_t mod8_width = width / 8 * 8;
+	size_t result = 0;
+	__m64 sum = _mm_setzero_si64();
+
+	for (size_t y = 0; y < height; ++y) {
+		for (size_t x = 0; x < mod8_width; x += 8) {
+			__m64 src = *reinterpret_cast<const __m64*>(src_ptr + x);
+			__m64 other = *reinterpret_cast<const __m64*>(other_ptr + x);
+			__m64 sad = _mm_sad_pu8(src, other);
+			sum = _mm_add_pi32(sum, sad);
+		}
+
+		for (size_t x = mod8_width; x < width; ++x) {
+			result += std::abs(src_ptr[x] - other_ptr[x]);
+		}
+
+		src_ptr += src_pitch;
+		other_ptr += other_pitch;
+	}
+	result += _mm_cvtsi64_si32(sum);
+	_mm_empty();
+	return result;
+}
+#endif
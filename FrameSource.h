@@ -0,0 +1,46 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+
+// One plane of a frame, in place in the host's frame buffer.
+struct PlaneView {
+	const uint8_t* data;
+	int pitch;                          // bytes from one row to the next
+	int rowSize;                        // bytes of pixels in a row
+	int height;
+	int pixelSize;                      // bytes per sample
+	int bits;                           // bits per sample, 32 for float
+	std::shared_ptr<const void> frame;  // keeps the host's frame alive while the view is in use, if needed
+};
+
+/**
+ * Frames of a source clip as the analysis sees them, implemented by each host (AviSynth clip,
+ * VapourSynth frames, files, an embedding application) so that the diff and cycle engines don't
+ * depend on one. Errors are reported by throwing, and reach the caller of the engine unchanged.
+ */
+class FrameSource {
+public:
+	virtual ~FrameSource() {}
+	virtual int frameCount() = 0;
+	virtual PlaneView luma(int n) = 0;
+};
@@ -0,0 +1,252 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <emmintrin.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include "3rd-party/avs/cpuid.h"
+#include "MotionInterp.h"
+#include "PlaneBlend.h"
+
+#define MOTION_MAX_LEVELS 4    // full resolution and up to three halvings, for up to 64 pixels of motion
+#define MOTION_COARSE_RANGE 4  // full search range on the coarsest level, in pixels of half motion
+#define MOTION_REFINE_RANGE 1  // search range around the vector predicted from the coarser level
+#define MOTION_LAMBDA 4        // SAD cost per pixel of vector length, which keeps flat areas from wandering off
+// Edge pixels replicated around each level, so that blocks at the edges can match content that moves in or out
+// of the frame. Covers the longest vector the search can reach on any level.
+#define MOTION_PAD 64
+
+static unsigned sadBlockC(const uint8_t* a, const uint8_t* b, int pitch) {
+	unsigned sad = 0;
+	for (int y = 0; y < MOTION_BLOCK; y++, a += pitch, b += pitch) {
+		for (int x = 0; x < MOTION_BLOCK; x++) {
+			sad += abs(a[x] - b[x]);
+		}
+	}
+	return sad;
+}
+
+// Two 8 pixel rows per register.
+static unsigned sadBlockSSE2(const uint8_t* a, const uint8_t* b, int pitch) {
+	__m128i sum = _mm_setzero_si128();
+	for (int y = 0; y < MOTION_BLOCK; y += 2, a += 2 * pitch, b += 2 * pitch) {
+		__m128i ra = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)),
+		                                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + pitch)));
+		__m128i rb = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)),
+		                                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + pitch)));
+		sum = _mm_add_epi32(sum, _mm_sad_epu8(ra, rb));
+	}
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+	return static_cast<unsigned>(_mm_cvtsi128_si32(sum));
+}
+
+// 8 bit copy of a luma plane, which is all the matching needs.
+static void toLuma8(const PlaneView& src, uint8_t* dst, int dstPitch) {
+	const int width = src.rowSize / src.pixelSize;
+	for (int y = 0; y < src.height; y++, dst += dstPitch) {
+		const uint8_t* row = src.data + y * src.pitch;
+		if (src.pixelSize == 1) {
+			memcpy(dst, row, width);
+		} else if (src.pixelSize == 2) {
+			const uint16_t* p = reinterpret_cast<const uint16_t*>(row);
+			for (int x = 0; x < width; x++) dst[x] = static_cast<uint8_t>(p[x] >> (src.bits - 8));
+		} else {
+			const float* p = reinterpret_cast<const float*>(row);
+			for (int x = 0; x < width; x++) dst[x] = static_cast<uint8_t>(std::min(std::max(p[x], 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+static void halve(const uint8_t* src, int srcPitch, uint8_t* dst, int dstPitch, int width, int height) {
+	for (int y = 0; y < height; y++, dst += dstPitch) {
+		const uint8_t* r0 = src + 2 * y * srcPitch;
+		const uint8_t* r1 = r0 + srcPitch;
+		for (int x = 0; x < width; x++) {
+			dst[x] = static_cast<uint8_t>((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+		}
+	}
+}
+
+// Fills the MOTION_PAD border around the width x height pixels at p with copies of the edge pixels.
+static void pad(uint8_t* p, int pitch, int width, int height) {
+	for (int y = 0; y < height; y++) {
+		uint8_t* row = p + y * pitch;
+		memset(row - MOTION_PAD, row[0], MOTION_PAD);
+		memset(row + width, row[width - 1], MOTION_PAD);
+	}
+	for (int y = 1; y <= MOTION_PAD; y++) {
+		memcpy(p - y * pitch - MOTION_PAD, p - MOTION_PAD, width + 2 * MOTION_PAD);
+		memcpy(p + (height - 1 + y) * pitch - MOTION_PAD, p + (height - 1) * pitch - MOTION_PAD, width + 2 * MOTION_PAD);
+	}
+}
+
+// Blocks cover the plane, the last one in a row or column moved in to end at the edge.
+static int blockOrigin(int block, int size) {
+	return std::min(block * MOTION_BLOCK, size - MOTION_BLOCK);
+}
+
+MotionInterpolator::MotionInterpolator(int cpuFlags) : cpuFlags(cpuFlags), lumaWidth(0), lumaHeight(0) {
+}
+
+void MotionInterpolator::search(const Level& level, const std::vector<Vector>* coarser, const Level* coarserLevel,
+                                std::vector<Vector>& out) const {
+	auto sad = (cpuFlags & CPUF_SSE2) ? sadBlockSSE2 : sadBlockC;
+	const int maxV = MOTION_PAD;                                // both displaced blocks stay within the padding
+	out.resize(level.blocksX * level.blocksY);
+
+	// Centers the search on the cheapest candidate and refines around it.
+	auto searchBlock = [&](int bx, int by, const Vector* candidates, int candidateCount, int range) {
+		const int x0 = blockOrigin(bx, level.width), y0 = blockOrigin(by, level.height);
+		auto cost = [&](int vx, int vy) {
+			const uint8_t* a = &level.prev[level.origin + (y0 - vy) * level.pitch + x0 - vx];
+			const uint8_t* b = &level.next[level.origin + (y0 + vy) * level.pitch + x0 + vx];
+			return sad(a, b, level.pitch) + MOTION_LAMBDA * (abs(vx) + abs(vy));
+		};
+
+		Vector best = { 0, 0 };
+		unsigned bestCost = cost(0, 0);
+		for (int i = 0; i < candidateCount; i++) {
+			Vector v = { std::min(std::max(candidates[i].x, -maxV), maxV), std::min(std::max(candidates[i].y, -maxV), maxV) };
+			unsigned c = cost(v.x, v.y);
+			if (c < bestCost) {
+				bestCost = c;
+				best = v;
+			}
+		}
+
+		const Vector center = best;
+		for (int vy = std::max(center.y - range, -maxV); vy <= std::min(center.y + range, maxV); vy++) {
+			for (int vx = std::max(center.x - range, -maxV); vx <= std::min(center.x + range, maxV); vx++) {
+				unsigned c = cost(vx, vy);
+				if (c < bestCost) {
+					bestCost = c;
+					best.x = vx;
+					best.y = vy;
+				}
+			}
+		}
+		out[by * level.blocksX + bx] = best;
+	};
+
+	// First pass in raster order. Candidates are the vectors of the coarser level's block and of its
+	// right and lower neighbours, and the vectors already found for the left and upper neighbours.
+	for (int by = 0; by < level.blocksY; by++) {
+		for (int bx = 0; bx < level.blocksX; bx++) {
+			Vector candidates[5];
+			int candidateCount = 0;
+			if (coarser) {
+				const int cx = std::min(bx / 2, coarserLevel->blocksX - 1), cy = std::min(by / 2, coarserLevel->blocksY - 1);
+				const int nx = std::min(cx + 1, coarserLevel->blocksX - 1), ny = std::min(cy + 1, coarserLevel->blocksY - 1);
+				for (const Vector& c : { (*coarser)[cy * coarserLevel->blocksX + cx], (*coarser)[cy * coarserLevel->blocksX + nx],
+				                         (*coarser)[ny * coarserLevel->blocksX + cx] }) {
+					candidates[candidateCount++] = { 2 * c.x, 2 * c.y };
+				}
+			}
+			if (bx > 0) candidates[candidateCount++] = out[by * level.blocksX + bx - 1];
+			if (by > 0) candidates[candidateCount++] = out[(by - 1) * level.blocksX + bx];
+			searchBlock(bx, by, candidates, candidateCount, coarser ? MOTION_REFINE_RANGE : MOTION_COARSE_RANGE);
+		}
+	}
+
+	// Second pass in reverse order, so that good vectors also spread left and up, into blocks at the
+	// edges or in repeating texture that the first pass got wrong.
+	for (int by = level.blocksY - 1; by >= 0; by--) {
+		for (int bx = level.blocksX - 1; bx >= 0; bx--) {
+			Vector candidates[3];
+			int candidateCount = 0;
+			candidates[candidateCount++] = out[by * level.blocksX + bx];
+			if (bx < level.blocksX - 1) candidates[candidateCount++] = out[by * level.blocksX + bx + 1];
+			if (by < level.blocksY - 1) candidates[candidateCount++] = out[(by + 1) * level.blocksX + bx];
+			searchBlock(bx, by, candidates, candidateCount, MOTION_REFINE_RANGE);
+		}
+	}
+}
+
+void MotionInterpolator::estimate(const PlaneView& prev, const PlaneView& next) {
+	lumaWidth = prev.rowSize / prev.pixelSize;
+	lumaHeight = prev.height;
+	vectors.clear();
+	if (lumaWidth < MOTION_BLOCK || lumaHeight < MOTION_BLOCK) return;
+
+	std::vector<Level> levels;
+	int width = lumaWidth, height = lumaHeight;
+	do {
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.pitch = (width + 2 * MOTION_PAD + 15) & ~15;
+		level.origin = MOTION_PAD * level.pitch + MOTION_PAD;
+		level.blocksX = (width + MOTION_BLOCK - 1) / MOTION_BLOCK;
+		level.blocksY = (height + MOTION_BLOCK - 1) / MOTION_BLOCK;
+		level.prev.resize(level.pitch * (height + 2 * MOTION_PAD));
+		level.next.resize(level.pitch * (height + 2 * MOTION_PAD));
+		uint8_t* prevp = &level.prev[level.origin];
+		uint8_t* nextp = &level.next[level.origin];
+		if (levels.empty()) {
+			toLuma8(prev, prevp, level.pitch);
+			toLuma8(next, nextp, level.pitch);
+		} else {
+			const Level& finer = levels.back();
+			halve(&finer.prev[finer.origin], finer.pitch, prevp, level.pitch, width, height);
+			halve(&finer.next[finer.origin], finer.pitch, nextp, level.pitch, width, height);
+		}
+		pad(prevp, level.pitch, width, height);
+		pad(nextp, level.pitch, width, height);
+		levels.push_back(std::move(level));
+		width /= 2;
+		height /= 2;
+	} while (levels.size() < MOTION_MAX_LEVELS && width >= 2 * MOTION_BLOCK && height >= 2 * MOTION_BLOCK);
+
+	std::vector<Vector> coarser;
+	for (int i = static_cast<int>(levels.size()) - 1; i >= 0; i--) {
+		bool coarsest = i == static_cast<int>(levels.size()) - 1;
+		search(levels[i], coarsest ? nullptr : &coarser, coarsest ? nullptr : &levels[i + 1], vectors);
+		coarser.swap(vectors);
+	}
+	vectors.swap(coarser);
+}
+
+void MotionInterpolator::compensate(uint8_t* dstp, int dstPitch, const uint8_t* prevp, const uint8_t* nextp, int pitch, int pitch2,
+                                    int rowsize, int height, int pixelsize, int subW, int subH) const {
+	PlaneBlend(dstp, dstPitch, prevp, nextp, pitch, pitch2, rowsize, height, pixelsize, cpuFlags);
+	if (vectors.empty()) return;
+
+	const int width = rowsize / pixelsize;
+	const int blockW = MOTION_BLOCK >> subW, blockH = MOTION_BLOCK >> subH;
+	const int blocksX = (lumaWidth + MOTION_BLOCK - 1) / MOTION_BLOCK;
+	const int blocksY = (lumaHeight + MOTION_BLOCK - 1) / MOTION_BLOCK;
+
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			const Vector& v = vectors[by * blocksX + bx];
+			if (v.x == 0 && v.y == 0) continue;                  // already blended in place
+			const int x0 = blockOrigin(bx, lumaWidth) >> subW, y0 = blockOrigin(by, lumaHeight) >> subH;
+			const int maxX = std::min(x0, width - blockW - x0), maxY = std::min(y0, height - blockH - y0);
+			if (maxX < 0 || maxY < 0) continue;
+			// truncating keeps subsampled blocks inside the plane along with their luma block
+			const int vx = std::min(std::max(v.x / (1 << subW), -maxX), maxX);
+			const int vy = std::min(std::max(v.y / (1 << subH), -maxY), maxY);
+			PlaneBlend(dstp + y0 * dstPitch + x0 * pixelsize, dstPitch,
+			           prevp + (y0 - vy) * pitch + (x0 - vx) * pixelsize, nextp + (y0 + vy) * pitch2 + (x0 + vx) * pixelsize,
+			           pitch, pitch2, blockW * pixelsize, blockH, pixelsize, cpuFlags);
+		}
+	}
+}
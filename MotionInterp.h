@@ -0,0 +1,71 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "FrameSource.h"
+
+// Block size of the motion search, in luma pixels on every pyramid level.
+#define MOTION_BLOCK 8
+
+/**
+ * Motion compensated frame halfway between two frames, the frame the motion synthesizer inserts
+ * at a skip. A much lighter take on MVTools' MAnalyse + MFlowInter, run only for the inserted frames.
+ *
+ * estimate() matches MOTION_BLOCK square blocks coarse to fine on a pyramid of 8 bit copies of the
+ * two lumas. The match is symmetric around the frame being made: for a block at p it looks for the
+ * vector v minimizing SAD(prev at p - v, next at p + v), so every block of the output gets exactly
+ * one vector and there are no holes to fill. Vectors are whole pixels. compensate() then averages
+ * the two displaced blocks into each plane, over a plain blend of the frames that covers the edges
+ * the block grid doesn't reach.
+ *
+ * One instance per frame made, estimate before compensate; instances aren't shared between threads.
+ */
+class MotionInterpolator {
+	struct Vector {
+		int x, y;   // half the motion from prev to next, in pixels of the level
+	};
+
+	struct Level {
+		std::vector<uint8_t> prev, next;
+		int width, height, pitch;
+		int origin;   // offset of the first pixel, inside the padding
+		int blocksX, blocksY;
+	};
+
+	int cpuFlags;
+	int lumaWidth, lumaHeight;
+	std::vector<Vector> vectors;   // per block of the full resolution luma, empty if it's smaller than a block
+
+	void search(const Level& level, const std::vector<Vector>* coarser, const Level* coarserLevel, std::vector<Vector>& out) const;
+
+public:
+	// cpuFlags are CPUF_* flags from avs/cpuid.h.
+	explicit MotionInterpolator(int cpuFlags);
+
+	// Estimates the motion between the luma planes of the frames around the skip.
+	void estimate(const PlaneView& prev, const PlaneView& next);
+
+	// Writes one plane of the halfway frame. subW and subH are the plane's subsampling shifts
+	// relative to the luma, pixelsize the bytes per sample.
+	void compensate(uint8_t* dstp, int dstPitch, const uint8_t* prevp, const uint8_t* nextp, int pitch, int pitch2,
+	                int rowsize, int height, int pixelsize, int subW, int subH) const;
+};
@@ -0,0 +1,73 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <string.h>
+#include "PerfCounters.h"
+
+PerfCounters::PerfCounters() {
+	for (Slot& slot : slots) {
+		for (auto& value : slot.values) {
+			value.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+int PerfCounters::threadSlot() {
+	static std::atomic<int> nextSlot(0);
+	thread_local int slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % PERF_SLOTS;
+	return slot;
+}
+
+uint64_t PerfCounters::total(PerfCounter counter) const {
+	uint64_t sum = 0;
+	for (const Slot& slot : slots) {
+		sum += slot.values[counter].load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+// One line of event count, total and mean time, for counters that have a time.
+static void writeTimed(FILE* f, const char* label, uint64_t count, uint64_t ns) {
+	fprintf(f, "  %-18s %10llu  total %10.1f ms  mean %8.3f ms\n", label, (unsigned long long)count,
+		ns / 1e6, count ? ns / 1e6 / count : 0.0);
+}
+
+void PerfCounters::write(FILE* f, const char* name) const {
+	fprintf(f, "%s\n", name);
+	fprintf(f, "  %-18s %10llu\n", "cycles analyzed", (unsigned long long)total(PERF_CYCLES));
+	writeTimed(f, "frame diffs", total(PERF_DIFFS), total(PERF_DIFF_NS));
+	fprintf(f, "  %-18s %10llu\n", "quick diffs", (unsigned long long)total(PERF_QUICK_DIFFS));
+	fprintf(f, "  %-18s c %llu, isse %llu, sse2 %llu, sse2 unaligned %llu\n", "diff kernels",
+		(unsigned long long)total(PERF_KERNEL_C), (unsigned long long)total(PERF_KERNEL_ISSE),
+		(unsigned long long)total(PERF_KERNEL_SSE2), (unsigned long long)total(PERF_KERNEL_SSE2_UNALIGNED));
+	writeTimed(f, "lock wait", total(PERF_LOCKS), total(PERF_LOCK_WAIT_NS));
+	writeTimed(f, "source frames", total(PERF_CHILD_FRAMES), total(PERF_CHILD_FRAME_NS));
+	writeTimed(f, "inserted frames", total(PERF_ALT_FRAMES), total(PERF_ALT_FRAME_NS));
+	fprintf(f, "  %-18s %10llu\n", "renders avoided", (unsigned long long)total(PERF_LOW_CONFIDENCE));
+	fprintf(f, "  %-18s %10llu\n", "static repeats", (unsigned long long)total(PERF_STATIC_REPEATS));
+	fflush(f);
+}
+
+bool PerfCounters::write(const char* path, const char* name) const {
+	FILE* f = strcmp(path, "-") == 0 ? stderr : fopen(path, "a");
+	if (!f) return false;
+	write(f, name);
+	if (f != stderr) fclose(f);
+	return true;
+}
@@ -0,0 +1,98 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+enum PerfCounter {
+	PERF_CYCLES,                   // cycles analyzed
+	PERF_DIFFS,                    // frame diffs computed, not counting ones looked up
+	PERF_DIFF_NS,                  // including fetching the two frames
+	PERF_QUICK_DIFFS,              // frame diffs estimated from a subset of rows, included in PERF_DIFFS
+	PERF_KERNEL_C,                 // diffs per SAD kernel, in PlaneKernel order
+	PERF_KERNEL_ISSE,
+	PERF_KERNEL_SSE2,
+	PERF_KERNEL_SSE2_UNALIGNED,
+	PERF_LOCKS,                    // acquisitions of the instance lock
+	PERF_LOCK_WAIT_NS,
+	PERF_CHILD_FRAMES,             // output frames fetched from the source clip
+	PERF_CHILD_FRAME_NS,
+	PERF_ALT_FRAMES,               // inserted output frames, fetched from the alt clip or synthesized
+	PERF_ALT_FRAME_NS,
+	PERF_LOW_CONFIDENCE,           // inserted frames blended instead of rendered, their cycle below the confidence threshold
+	PERF_STATIC_REPEATS,           // inserted frames repeating a source frame, their cycle static
+	PERF_COUNTERS
+};
+
+// Threads beyond this many share slots, which is still correct, only slower.
+#define PERF_SLOTS 64
+
+/**
+ * Cheap always-on counters of one filter instance. Each thread adds to its own slot, on its own
+ * cache lines, with relaxed atomic adds, so counting neither locks nor bounces cache lines
+ * between threads. Totals are summed over the slots when read.
+ */
+class PerfCounters {
+	struct Slot {
+		std::atomic<uint64_t> values[PERF_COUNTERS];
+		char padding[64];          // keeps neighbouring slots off each other's cache lines
+	};
+	Slot slots[PERF_SLOTS];
+
+	static int threadSlot();
+
+public:
+	PerfCounters();
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	void add(PerfCounter counter, uint64_t value = 1) {
+		slots[threadSlot()].values[counter].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	uint64_t total(PerfCounter counter) const;
+
+	// Summary of all counters, headed by the name of the instance.
+	void write(FILE* f, const char* name) const;
+	// Appends the summary to the file at path, or writes it to stderr for "-". Returns false if the file can't be opened.
+	bool write(const char* path, const char* name) const;
+};
+
+/**
+ * Counts one event and its duration on destruction. Does nothing if counters is null.
+ */
+class PerfTimer {
+	PerfCounters* counters;
+	PerfCounter count, ns;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	PerfTimer(PerfCounters* counters, PerfCounter count, PerfCounter ns) : counters(counters), count(count), ns(ns) {
+		if (counters) start = std::chrono::steady_clock::now();
+	}
+	~PerfTimer() {
+		if (!counters) return;
+		counters->add(count);
+		counters->add(ns, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+};
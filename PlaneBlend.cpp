@@ -0,0 +1,79 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <emmintrin.h>
+#include "3rd-party/avs/cpuid.h"
+#include "PlaneBlend.h"
+
+template<typename pixel_t>
+static void blendRowC(pixel_t* dst, const pixel_t* a, const pixel_t* b, int width) {
+	for (int x = 0; x < width; x++) {
+		dst[x] = static_cast<pixel_t>((a[x] + b[x] + 1) >> 1);
+	}
+}
+
+static void blendRowC(float* dst, const float* a, const float* b, int width) {
+	for (int x = 0; x < width; x++) {
+		dst[x] = (a[x] + b[x]) * 0.5f;
+	}
+}
+
+// 16 bytes at a time with unaligned loads, which cost next to nothing on aligned data. Returns the bytes done.
+template<int pixelsize>
+static int blendRowSSE2(uint8_t* dst, const uint8_t* a, const uint8_t* b, int rowsize) {
+	const int mod16 = rowsize & ~15;
+	for (int x = 0; x < mod16; x += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+		__m128i avg;
+		if (pixelsize == 1) {
+			avg = _mm_avg_epu8(va, vb);
+		} else if (pixelsize == 2) {
+			avg = _mm_avg_epu16(va, vb);
+		} else {
+			__m128 sum = _mm_add_ps(_mm_castsi128_ps(va), _mm_castsi128_ps(vb));
+			avg = _mm_castps_si128(_mm_mul_ps(sum, _mm_set1_ps(0.5f)));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), avg);
+	}
+	return mod16;
+}
+
+template<typename pixel_t, int pixelsize>
+static void blendPlane(uint8_t* dstp, int dstPitch, const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2,
+                       int rowsize, int height, bool sse2) {
+	for (int y = 0; y < height; y++) {
+		int done = sse2 ? blendRowSSE2<pixelsize>(dstp, srcp, srcp2, rowsize) : 0;
+		blendRowC(reinterpret_cast<pixel_t*>(dstp + done), reinterpret_cast<const pixel_t*>(srcp + done),
+		          reinterpret_cast<const pixel_t*>(srcp2 + done), (rowsize - done) / pixelsize);
+		dstp += dstPitch;
+		srcp += pitch;
+		srcp2 += pitch2;
+	}
+}
+
+void PlaneBlend(uint8_t* dstp, int dstPitch, const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2,
+                int rowsize, int height, int pixelsize, int cpuFlags) {
+	bool sse2 = (cpuFlags & CPUF_SSE2) != 0;
+	switch (pixelsize) {
+	case 1: blendPlane<uint8_t, 1>(dstp, dstPitch, srcp, srcp2, pitch, pitch2, rowsize, height, sse2); break;
+	case 2: blendPlane<uint16_t, 2>(dstp, dstPitch, srcp, srcp2, pitch, pitch2, rowsize, height, sse2); break;
+	case 4: blendPlane<float, 4>(dstp, dstPitch, srcp, srcp2, pitch, pitch2, rowsize, height, sse2); break;
+	}
+}
@@ -0,0 +1,29 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Host independent per pixel mean of two planes, the frame the blend synthesizer inserts. The weights are
+// fixed at 1/2, as an inserted frame is shown halfway between the source frames around the skip.
+// Same plane parameters as PlaneDiff; cpuFlags are CPUF_* flags from avs/cpuid.h.
+// Integer pixels are rounded half up, as pavgb/pavgw do. dstp may be one of the sources.
+void PlaneBlend(uint8_t* dstp, int dstPitch, const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2,
+                int rowsize, int height, int pixelsize, int cpuFlags);
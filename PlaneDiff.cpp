@@ -0,0 +1,124 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Kernel dispatch, extracted from YDiff in FrameDiff.cpp.
+
+#include <stdint.h>
+#include <limits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include "3rd-party/avs/cpuid.h"
+#include "PlaneDiff.h"
+#include "FrameDiffKernels.h"
+
+#define IS_POWER2(n) ((n) && !((n) & ((n) - 1)))
+#define IS_PTR_ALIGNED(ptr, align) (((uintptr_t)ptr & ((uintptr_t)(align-1))) == 0)
+
+template<typename T>
+static bool IsPtrAligned(T* ptr, size_t align)
+{
+	IS_POWER2(align);
+	return (bool)IS_PTR_ALIGNED(ptr, align);
+}
+
+double PlaneSAD(const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2, int rowsize, int height, int pixelsize, int bits_per_pixel, int cpuFlags,
+                PlaneKernel* kernel) {
+	int width = rowsize / pixelsize;
+#ifdef X86_32
+	// the ISSE kernel sums in 32 bits
+	int total_pixels = width * height;
+	bool sum_in_32bits;
+	if (pixelsize == 4)
+		sum_in_32bits = false;
+	else // worst case check
+		sum_in_32bits = ((__int64)total_pixels * ((1 << bits_per_pixel) - 1)) <= std::numeric_limits<int>::max();
+#endif
+
+	bool sse2 = (cpuFlags & CPUF_SSE2) && rowsize >= 16;
+	bool aligned = IsPtrAligned(srcp, 16) && IsPtrAligned(srcp2, 16) && pitch % 16 == 0 && pitch2 % 16 == 0;
+
+	double sad = 0;
+	PlaneKernel used = PLANE_KERNEL_C;
+	// for c: width, for sse: rowsize
+	{
+		if ((pixelsize == 2) && sse2 && aligned) {
+			sad = (double)calculate_sad_8_or_16_sse2<uint16_t, false, true>(srcp, srcp2, pitch, pitch2, rowsize, height); // in focus, no overflow
+			used = PLANE_KERNEL_SSE2;
+		}
+		else if ((pixelsize == 1) && sse2 && aligned) {
+			sad = (double)calculate_sad_8_or_16_sse2<uint8_t, false, true>(srcp, srcp2, pitch, pitch2, rowsize, height); // in focus, no overflow
+			used = PLANE_KERNEL_SSE2;
+		}
+		else if ((pixelsize == 2) && sse2) {   // e.g. planes read in place from a file
+			sad = (double)calculate_sad_8_or_16_sse2<uint16_t, false, false>(srcp, srcp2, pitch, pitch2, rowsize, height);
+			used = PLANE_KERNEL_SSE2_UNALIGNED;
+		}
+		else if ((pixelsize == 1) && sse2) {
+			sad = (double)calculate_sad_8_or_16_sse2<uint8_t, false, false>(srcp, srcp2, pitch, pitch2, rowsize, height);
+			used = PLANE_KERNEL_SSE2_UNALIGNED;
+		}
+		else
+#ifdef X86_32
+			if ((pixelsize == 1) && sum_in_32bits && (cpuFlags & CPUF_INTEGER_SSE) && width >= 8) {
+				sad = get_sad_isse(srcp, srcp2, height, width, pitch, pitch2);
+				used = PLANE_KERNEL_ISSE;
+			}
+			else
+#endif
+			{
+				if (pixelsize == 1)
+					sad = get_sad_c<uint8_t>(srcp, srcp2, height, width, pitch, pitch2);
+				else if (pixelsize == 2)
+					sad = get_sad_c<uint16_t>(srcp, srcp2, height, width, pitch, pitch2);
+				else // pixelsize==4
+					sad = get_sad_c<float>(srcp, srcp2, height, width, pitch, pitch2);
+			}
+	}
+
+	if (kernel) *kernel = used;
+	return sad;
+}
+
+float PlaneDiff(const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2, int rowsize, int height, int pixelsize, int bits_per_pixel, int cpuFlags,
+                PlaneKernel* kernel) {
+	int width = rowsize / pixelsize;
+	double sad = PlaneSAD(srcp, srcp2, pitch, pitch2, rowsize, height, pixelsize, bits_per_pixel, cpuFlags, kernel);
+	// on the 8-bit scale, so that scene and static thresholds mean the same at every bit depth
+	double scale = pixelsize == 4 ? 255.0 : 1.0 / (1 << (bits_per_pixel - 8));
+	return (float)(sad * scale / ((double)height * width));
+}
+
+int DetectCPUFlags() {
+	unsigned int edx;
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	edx = static_cast<unsigned int>(info[3]);
+#else
+	unsigned int eax, ebx, ecx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+#endif
+	int flags = 0;
+	if (edx & (1 << 23)) flags |= CPUF_MMX;
+	if (edx & (1 << 25)) flags |= CPUF_SSE | CPUF_INTEGER_SSE;
+	if (edx & (1 << 26)) flags |= CPUF_SSE2;
+	return flags;
+}
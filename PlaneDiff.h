@@ -0,0 +1,45 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <stdint.h>
+
+// Host independent frame difference of a single plane, as used by YDiff and the analyzer tools.
+// bits_per_pixel is the component bit depth, 32 for float. cpuFlags are CPUF_* flags from avs/cpuid.h.
+
+// SAD kernels, as reported by PlaneSAD.
+enum PlaneKernel {
+	PLANE_KERNEL_C,
+	PLANE_KERNEL_ISSE,
+	PLANE_KERNEL_SSE2,
+	PLANE_KERNEL_SSE2_UNALIGNED
+};
+
+// Sum of absolute differences of two planes, using the fastest kernel the CPU flags and plane layout allow.
+// The kernel used is stored in kernel, if given.
+double PlaneSAD(const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2, int rowsize, int height, int pixelsize, int bits_per_pixel, int cpuFlags,
+                PlaneKernel* kernel = nullptr);
+
+// Mean absolute difference per pixel of two planes, the diff value the cycles are ranked by. It is scaled to
+// 8-bit samples: divided by 2^(bits - 8) for integer samples, multiplied by 255 for float ones.
+float PlaneDiff(const uint8_t* srcp, const uint8_t* srcp2, int pitch, int pitch2, int rowsize, int height, int pixelsize, int bits_per_pixel, int cpuFlags,
+                PlaneKernel* kernel = nullptr);
+
+// CPUF_* flags of the running CPU, for callers that don't get them from an AviSynth environment.
+int DetectCPUFlags();
@@ -16,138 +16,285 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
 // USA.
 
-#include <Windows.h>
 #include <mutex>
+#include <algorithm>
 #include <stdio.h>
+#include <stdexcept>
+#ifdef SMOOTHSKIP_BENCH
+#include <chrono>
+#endif
 #include "SmoothSkip.h"
-#include "CycleCache.h"
-#include "Cycle.h"
+#include "FixedCycle.h"
 #include "FrameDiff.h"
+#include "AnalysisFile.h"
+#include "MotionInterp.h"
+#include "PlaneBlend.h"
 #include "3rd-party/info.h"
 
-#ifdef _DEBUG
-// #define DEBUG
-#endif
-
 void raiseError(IScriptEnvironment* env, const char* msg);
 double GetFps(PClip clip);
 
+const AVS_Linkage* AVS_linkage = 0;
+extern "C" SMOOTHSKIP_EXPORT const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* env, const AVS_Linkage* const vectors) {
+	AVS_linkage = vectors;
+	env->AddFunction("SmoothSkip", "c[ALTCLIP]c[CYCLE]i[CREATE]i[OFFSET]f[SCENE]i[DEBUG]b[CACHE]i[SPILL]b[SEGMENT_START]i[SEGMENT_END]i[INPUT]s[STATS]s[TRACE]s[SYNTH]s[CONFIDENCE]f[STATIC]f[QPFILE]s[ZONES]s[ZONE_OPTIONS]s[MODE]s[TIMECODES]s[DUPES]i[DEBUGLOG]s", Create_SmoothSkip, 0);
+
+	ScriptDiffs* scriptDiffs = new ScriptDiffs();
+	env->AtExit(Free_ScriptDiffs, scriptDiffs);
+	env->AddFunction("SmoothSkipYDiff", "ci[OFFSET]i", Create_SmoothSkipYDiff, scriptDiffs);
+	return "'SmoothSkip' plugin v" VERSION ", author: tinjon[at]gmail.com";
+}
+
 // ==========================================================================
 // PUBLIC methods
 // ==========================================================================
 
 PVideoFrame __stdcall SmoothSkip::GetFrame(int n, IScriptEnvironment* env) {
 	PVideoFrame frame;
+	CycleSnapshot cycle;
+	TraceSpan span(trace.get(), TRACE_FRAME, n);
 
-	Cycle &cycle = *cycles->GetCycleForFrame(n);
-
-#ifdef DEBUG
-	printf("frame %d, cycle-address %X, thread-id: %X\n", n, (unsigned int)&cycle, GetCurrentThreadId());
-#endif
+	n += segmentStart;                                          // frame number in the full, unsegmented output
 
 	// Comparison of the source clip's previous frame is currently done single-threaded.
-	FrameMap map = getFrameMapping(env, n);
+	// Retimed output is the source frames, so it only maps the cycle's first output frame, which
+	// has the cycle analyzed for the timecodes.
+	FrameMap map = getFrameMapping(env, retime ? n / engine->length * (engine->length + engine->creates) : n,
+	                               debug || debugLog ? &cycle : nullptr);
 
 	// Fetching the alternative clip, or the source clip a second time
 	// (from avisynth-cache) is done multi-threaded.
-	int cn = map.srcframe, acn = cn;
-	bool alt = map.altclip;
-
-	if (alt) {
-		acn = max(cn + offset, 0);                              // original frame number for alternate clip, offset as specified by user.
-		acn = min(acn, altclip->GetVideoInfo().num_frames - 1); // ensure the altclip frame to get is 0 <= x <= [last frame number] in alt clip
+	int cn = retime ? n : map.srcframe, acn = cn;
+	bool alt = map.altclip && !retime;
+	SynthMode mode = map.lowConfidence ? SYNTH_BLEND : synth;    // no real skip, not worth rendering
+
+	if (alt && map.staticCycle) {
+		PerfTimer timer(&counters, PERF_ALT_FRAMES, PERF_ALT_FRAME_NS);
+		TraceSpan altSpan(trace.get(), TRACE_ALT_FRAME, cn);
+		counters.add(PERF_STATIC_REPEATS);
+		frame = child->GetFrame(cn, env);                            // nothing moves, so the source frame itself will do
+	} else if (alt && mode != SYNTH_ALTCLIP) {
+		PerfTimer timer(&counters, PERF_ALT_FRAMES, PERF_ALT_FRAME_NS);
+		TraceSpan altSpan(trace.get(), TRACE_ALT_FRAME, cn);
+		if (mode != synth) counters.add(PERF_LOW_CONFIDENCE);
+		frame = synthesize(env, std::max(cn - 1, 0), cn, mode);     // the skip is between the previous frame and cn
+	} else if (alt) {
+		acn = std::max(cn + offset, 0);                              // original frame number for alternate clip, offset as specified by user.
+		acn = std::min(acn, altclip->GetVideoInfo().num_frames - 1); // ensure the altclip frame to get is 0 <= x <= [last frame number] in alt clip
+		PerfTimer timer(&counters, PERF_ALT_FRAMES, PERF_ALT_FRAME_NS);
+		TraceSpan altSpan(trace.get(), TRACE_ALT_FRAME, acn);
 		frame = altclip->GetFrame(acn, env);
 	} else {
+		PerfTimer timer(&counters, PERF_CHILD_FRAMES, PERF_CHILD_FRAME_NS);
+		TraceSpan childSpan(trace.get(), TRACE_CHILD_FRAME, cn);
 		frame = child->GetFrame(cn, env);
 	}
 
 	if (debug) {
 		char msg[256];
 		int row = 0;
+		env->MakeWritable(&frame);                                   // once, the lines are drawn in place
 		sprintf(msg, "SmoothSkip v%s", VERSION);
-		frame = info(env, frame, msg, 0, row++);
+		info(frame, msg, 0, row++);
 		sprintf(msg, "Frame: %d (child: %d)", n, cn);
-		frame = info(env, frame, msg, 0, row++);
-		sprintf(msg, "Using: %d, clip %s", (alt ? acn : cn), (alt ? "B" : "A"));
-		frame = info(env, frame, msg, 0, row++);
+		info(frame, msg, 0, row++);
+		if (alt && map.staticCycle)
+			sprintf(msg, "Using: %d, clip A (static)", cn);
+		else if (alt && mode != SYNTH_ALTCLIP)
+			sprintf(msg, "Using: %d+%d, %s%s", std::max(cn - 1, 0), cn, mode == SYNTH_BLEND ? "blend" : "motion",
+				mode != synth ? " (low confidence)" : "");
+		else
+			sprintf(msg, "Using: %d, clip %s", (alt ? acn : cn), (alt ? "B" : "A"));
+		info(frame, msg, 0, row++);
 		sprintf(msg, "FPS:   %.3f (child: %.3f)", GetFps(this), GetFps(child));
-		frame = info(env, frame, msg, 0, row++);
-		sprintf(msg, "Scene: %.1f", sceneThreshold);
-		frame = info(env, frame, msg, 0, row++);
+		info(frame, msg, 0, row++);
+		sprintf(msg, "Scene: %.1f", cycle.sceneThreshold);
+		info(frame, msg, 0, row++);
+		sprintf(msg, "Confidence: %.2f", cycle.confidence);
+		info(frame, msg, 0, row++);
 		sprintf(msg, "Cycle frame diffs (child):");
-		frame = info(env, frame, msg, 0, row++);
-		for (int i = 0; i < cycle.length; i++) {
-			sprintf(msg, "%s %d (%.5f) ",
-				cycle.isSceneChange(cycle.diffs[i].frame) ? "S" : cycle.isBadFrame(cycle.diffs[i].frame) ? "*" : " ",
+		info(frame, msg, 0, row++);
+		for (size_t i = 0; i < cycle.diffs.size(); i++) {
+			sprintf(msg, "%c %d (%.5f) ",
+				cycle.marks[i],
 				cycle.diffs[i].frame,
 				cycle.diffs[i].diff);
-			frame = info(env, frame, msg, 0, row++);
+			info(frame, msg, 0, row++);
 		}
 	}
 
-	return frame;
-}
-
-void SmoothSkip::updateCycle(IScriptEnvironment* env, int cn, VideoInfo cvi, Cycle& cycle) {
-	float diff = 0;
-	int i, j;
-
-	cycle.reset();
-
-	int cycleStartFrame = (cn / cycle.length) * cycle.length;
-	int cycleEndFrame = min(cycleStartFrame + cycle.length - 1, cvi.num_frames - 1);
-
-	for (i = cycleStartFrame, j = 0; i <= cycleEndFrame; i++, j++) {
-		diff = GetDiffFromPrevious(env, i);
-		cycle.diffs[j].frame = i;
-		cycle.diffs[j].diff = diff;
+	if (debugLog) {                                                  // the same, without touching the frame
+		const char* clip = !alt ? "A" : map.staticCycle ? "static" : mode == SYNTH_ALTCLIP ? "B" : mode == SYNTH_BLEND ? "blend" : "motion";
+		debugLog->add(n, acn, clip, std::move(cycle));
 	}
 
-	cycle.updateFrameMap();
+	return frame;
 }
 
 // Constructor
-SmoothSkip::SmoothSkip(PClip _child, PClip _altclip, int cycleLen, int creates, int _offset, 
-	                   double sceneThresh, bool _debug, IScriptEnvironment* env) :
-GenericVideoFilter(_child), altclip(_altclip), offset(_offset), debug(_debug) {
-	VideoInfo avi = altclip->GetVideoInfo();
+SmoothSkip::SmoothSkip(PClip _child, PClip _altclip, SynthMode _synth, int cycleLen, int creates, int dupes, int _offset, 
+	                   double sceneThresh, double confidence, double staticFloor, bool _debug, CycleFactory cycleFactory, int cacheCycles, bool spill,
+	                   int segmentStartFrame, int segmentEndFrame, const char* inputFile, const char* _statsFile, const char* _traceFile,
+	                   const char* qpFile, const char* zonesFile, const char* zoneOptions, bool _retime, const char* timecodesFile,
+	                   const char* debugLogFile, IScriptEnvironment* env) :
+GenericVideoFilter(_child), altclip(_altclip), synth(_synth), cpuFlags(env->GetCPUFlags()), debug(_debug), offset(_offset), segmentStart(0), retime(_retime), statsFile(_statsFile ? _statsFile : ""), traceFile(_traceFile ? _traceFile : "") {
 	VideoInfo cvi = child->GetVideoInfo();
 	if (!(vi.IsYV12() || vi.IsYUY2())) raiseError(env, "Input clip must be YV12 or YUY2");
-	if (!(avi.IsYV12() || avi.IsYUY2())) raiseError(env, "Alternate clip must be YV12 or YUY2");
+	if (synth == SYNTH_MOTION && !vi.IsPlanar()) raiseError(env, "Synth \"motion\" needs a planar input clip");
+	if (synth == SYNTH_ALTCLIP && !retime) {
+		if (!altclip) raiseError(env, "Alternate clip is required with synth=\"altclip\"");
+		VideoInfo avi = altclip->GetVideoInfo();
+		if (!(avi.IsYV12() || avi.IsYUY2())) raiseError(env, "Alternate clip must be YV12 or YUY2");
+		if (cycleLen > avi.num_frames) raiseError(env, "Cycle can't be larger than the frames in alt clip");
+	}
 
 	if (cycleLen < 1) raiseError(env, "Cycle must be > 0");
 	if (cycleLen > cvi.num_frames) raiseError(env, "Cycle can't be larger than the frames in source clip");
-	if (cycleLen > avi.num_frames) raiseError(env, "Cycle can't be larger than the frames in alt clip");
 	if (creates < 1 || creates > cycleLen) raiseError(env, "Create must be between 1 and the value of cycle (1 <= create <= cycle)");
+	if (dupes < 0 || dupes > cycleLen - creates) raiseError(env, "Dupes must be between 0 and cycle - create (0 <= dupes <= cycle - create)");
 	if (sceneThresh < 0) raiseError(env, "Scene threshold must be >= 0.0");
+	if (confidence < 0) raiseError(env, "Confidence must be >= 0.0");
+	if (staticFloor < 0) raiseError(env, "Static noise floor must be >= 0.0");
+	if (retime && !(timecodesFile && *timecodesFile)) raiseError(env, "Mode \"timecodes\" needs a timecodes file");
+	if (retime && dupes > 0) raiseError(env, "Mode \"timecodes\" can't drop dupes");
+	if (!retime && timecodesFile && *timecodesFile) raiseError(env, "A timecodes file is only written with mode=\"timecodes\"");
+	if (cacheCycles < 0) raiseError(env, "Cache must be >= 0");
 
-	sceneThreshold = static_cast<float>(sceneThresh); // Assign to static variable in the cycle header, so it can be used in the cycle logic
+	if (segmentEndFrame < 0) segmentEndFrame = cvi.num_frames - 1;
+	if (segmentStartFrame < 0 || segmentStartFrame > segmentEndFrame || segmentEndFrame >= cvi.num_frames)
+		raiseError(env, "Segment must satisfy 0 <= segment_start <= segment_end < frames in source clip");
 
 	try {
-		cycles = new CycleCache(cycleLen, creates, cvi.num_frames);
+		engine.reset(new CycleEngine(cvi.num_frames, cycleLen, creates, dupes, static_cast<float>(sceneThresh), cycleFactory,
+		                             env->GetCPUFlags(), cacheCycles, spill));
 	}
 	catch (std::bad_alloc) {
 		raiseError(env, "Failed to allocate cycle memory");
 	}
+	engine->setCounters(&counters);
+	engine->setConfidence(static_cast<float>(confidence));
+	engine->setStaticFloor(static_cast<float>(staticFloor));
+	if (!traceFile.empty()) {
+		trace.reset(new TraceRecorder());
+		engine->setTrace(trace.get());
+	}
+
+	if (inputFile && *inputFile) {                                // diffs computed up front, e.g. by smoothskip_analyze
+		AnalysisHeader header = {};
+		try {
+			header = readAnalysisHeader(inputFile);
+		}
+		catch (std::runtime_error& e) {
+			raiseError(env, e.what());
+		}
+		if (header.frames != (uint32_t)cvi.num_frames) raiseError(env, "Input analysis file doesn't have the same number of frames as the source clip");
+		if (header.width != (uint32_t)cvi.width || header.height != (uint32_t)cvi.height)
+			raiseError(env, "Input analysis file was made from a clip of another frame size");
+		if (header.bits != (uint32_t)BitsPerComponent(cvi)) raiseError(env, "Input analysis file was made from a clip of another bit depth");
+
+		AnalysisFile input;
+		try {
+			input = readAnalysisFile(inputFile);
+		}
+		catch (std::exception& e) {                               // std::bad_alloc too
+			raiseError(env, e.what());
+		}
+		engine->diffs.usePrecomputed(std::move(input.diffs));
+	}
+	// The shared analysis holds a diff for every frame of the clip, which a bounded cache is meant to avoid.
+	// PClips are copied around, so the clip is identified by the IClip they point to.
+	else if (cacheCycles == 0) {
+		std::shared_ptr<const void> source(std::make_shared<PClip>(child), child.operator->());
+		engine->diffs.useShared(acquireSharedAnalysis(source, cvi.num_frames, -1));
+	}
+
+	if (!retime) {                                                // retimed output keeps the source frames and their average rate
+		vi.MulDivFPS(cycleLen + creates - dupes, cycleLen);
+		vi.num_frames = engine->outputFrameCount();
+	}
 
-	int newFrames = (vi.num_frames / cycleLen) * creates;    // a non-full last cycle will still introduce a new frame.
-	newFrames += min(vi.num_frames % cycleLen, creates);     // account for when the last clip cycle isn't a full one.
-	vi.MulDivFPS(cycleLen + creates, cycleLen);
-	vi.num_frames += newFrames;
+	// A segment consists of the cycles that start within it, so adjacent segments split the clip on
+	// cycle boundaries and the analysis of every cycle is identical to that of an unsegmented run.
+	int firstCycle = (segmentStartFrame + cycleLen - 1) / cycleLen;
+	int lastCycle = segmentEndFrame / cycleLen;
+	if (firstCycle > lastCycle) raiseError(env, "Segment must include the first frame of at least one cycle");
+
+	const int outputCycle = retime ? cycleLen : cycleLen + creates - dupes;
+	segmentStart = firstCycle * outputCycle;
+	int segmentEnd = std::min((lastCycle + 1) * outputCycle, vi.num_frames) - 1;
+	vi.num_frames = segmentEnd - segmentStart + 1;
+
+	if ((qpFile && *qpFile) || (zonesFile && *zonesFile) || retime) {   // numbered as this segment's frames, which the encoder sees
+		double frameMs = 1000.0 * cvi.fps_denominator * cycleLen / ((double)cvi.fps_numerator * (cycleLen + creates));
+		try {
+			hints.reset(new EncoderHints(qpFile ? qpFile : "", zonesFile ? zonesFile : "", zoneOptions, retime ? timecodesFile : "",
+			                             frameMs, cycleLen, firstCycle, lastCycle));
+		}
+		catch (std::runtime_error& e) {
+			raiseError(env, e.what());
+		}
+		engine->setHints(hints.get());
+	}
+
+	if (debugLogFile && *debugLogFile) {
+		try {
+			debugLog.reset(new DebugLog(debugLogFile, cycleLen));
+		}
+		catch (std::runtime_error& e) {
+			raiseError(env, e.what());
+		}
+	}
 }
 
 SmoothSkip::~SmoothSkip() {
-	delete cycles;
+	if (!statsFile.empty()) {
+		writeStats(statsFile.c_str());
+	}
+	if (trace) {
+		trace->write(traceFile.c_str());
+	}
 }
 
 AVSValue __cdecl Create_SmoothSkip(AVSValue args, void* user_data, IScriptEnvironment* env) {
+	int cycle = args[2].AsInt(4);
+	int create = args[3].AsInt(1);
+	int dupes = args[22].AsInt(0);
+	PClip altclip;
+	if (args[1].Defined()) altclip = args[1].AsClip();
+
+	const char* mode = args[20].AsString("insert");
+	bool retime = !strcmp(mode, "timecodes");
+	if (!retime && strcmp(mode, "insert")) raiseError(env, "Mode must be \"insert\" or \"timecodes\"");
+
+	SynthMode synth = SYNTH_ALTCLIP;
+	if (!parseSynthMode(args[14].AsString(altclip ? "altclip" : "blend"), synth))
+		raiseError(env, "Synth must be \"altclip\", \"blend\" or \"motion\"");
+
 	return new SmoothSkip(args[0].AsClip(),
-		args[1].AsClip(),      // altclip
-		args[2].AsInt(4),      // cycle
-		args[3].AsInt(1),      // create
+		altclip,               // altclip
+		synth,                 // synth
+		cycle,                 // cycle
+		create,                // create
+		dupes,                 // dupes
 		args[4].AsInt(0),      // offset
-		args[5].AsFloat(32),   // offset
+		args[5].AsFloat(32),   // scene
+		args[15].AsFloat(0),   // confidence
+		args[16].AsFloat(0),   // static
 		args[6].AsBool(false), // debug
+		selectCycleFactory(cycle, create, dupes), // compile-time specialized cycle for common cycle/create pairs
+		args[7].AsInt(0),      // cache
+		args[8].AsBool(false), // spill
+		args[9].AsInt(0),      // segment_start
+		args[10].AsInt(-1),    // segment_end
+		args[11].AsString(""), // input
+		args[12].AsString(""), // stats
+		args[13].AsString(""), // trace
+		args[17].AsString(""), // qpfile
+		args[18].AsString(""), // zones
+		args[19].AsString("b=0.75"), // zone_options
+		retime,                // mode
+		args[21].AsString(""), // timecodes
+		args[23].AsString(""), // debuglog
 		env);
 }
 
@@ -156,10 +303,40 @@ AVSValue __cdecl Create_SmoothSkip(AVSValue args, void* user_data, IScriptEnviro
 //  Helper functions
 // ========================================================================
 
-PVideoFrame SmoothSkip::info(IScriptEnvironment* env, PVideoFrame src, char* msg, int x, int y) {
-	env->MakeWritable(&src);
-	DrawString(src, x, y, msg, child->GetVideoInfo().IsYUY2());
-	return src;
+// frame must be writable.
+void SmoothSkip::info(PVideoFrame& frame, const char* msg, int x, int y) {
+	DrawString(frame, x, y, msg, child->GetVideoInfo().IsYUY2(), cpuFlags);
+}
+
+// Frame halfway between child frames n1 and n2, in all planes, made as mode, SYNTH_BLEND or SYNTH_MOTION, says.
+PVideoFrame SmoothSkip::synthesize(IScriptEnvironment* env, int n1, int n2, SynthMode mode) {
+	PVideoFrame a = child->GetFrame(n1, env);
+	PVideoFrame b = child->GetFrame(n2, env);
+	PVideoFrame dst = env->NewVideoFrame(vi);
+	const int planes[] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+	const int planeCount = vi.IsPlanar() && !vi.IsY() ? 3 : 1;    // packed YUY2 is blended as one plane of bytes
+	const int pixelSize = ComponentSize(vi);
+
+	MotionInterpolator motion(cpuFlags);
+	if (mode == SYNTH_MOTION) {
+		PlaneView prev = { a->GetReadPtr(PLANAR_Y), a->GetPitch(PLANAR_Y), a->GetRowSize(PLANAR_Y), a->GetHeight(PLANAR_Y), pixelSize, BitsPerComponent(vi), nullptr };
+		PlaneView next = { b->GetReadPtr(PLANAR_Y), b->GetPitch(PLANAR_Y), b->GetRowSize(PLANAR_Y), b->GetHeight(PLANAR_Y), pixelSize, BitsPerComponent(vi), nullptr };
+		motion.estimate(prev, next);
+	}
+
+	for (int i = 0; i < planeCount; i++) {
+		int plane = planes[i];
+		if (mode == SYNTH_MOTION) {
+			int subW = i ? vi.GetPlaneWidthSubsampling(plane) : 0;
+			int subH = i ? vi.GetPlaneHeightSubsampling(plane) : 0;
+			motion.compensate(dst->GetWritePtr(plane), dst->GetPitch(plane), a->GetReadPtr(plane), b->GetReadPtr(plane),
+				a->GetPitch(plane), b->GetPitch(plane), dst->GetRowSize(plane), dst->GetHeight(plane), pixelSize, subW, subH);
+		} else {
+			PlaneBlend(dst->GetWritePtr(plane), dst->GetPitch(plane), a->GetReadPtr(plane), b->GetReadPtr(plane),
+				a->GetPitch(plane), b->GetPitch(plane), dst->GetRowSize(plane), dst->GetHeight(plane), pixelSize, cpuFlags);
+		}
+	}
+	return dst;
 }
 
 double GetFps(PClip clip) {
@@ -167,35 +344,48 @@ double GetFps(PClip clip) {
 	return (double)info.fps_numerator / (double)info.fps_denominator;
 }
 
-float SmoothSkip::GetDiffFromPrevious(IScriptEnvironment* env, int n) {
-	return YDiff(child, n, -1, env);
-}
-
-FrameMap SmoothSkip::getFrameMapping(IScriptEnvironment* env, int n) {
-	Cycle& cycle = *cycles->GetCycleForFrame(n);
-	int cycleCount = n / (cycle.length + cycle.creates);
-	int cycleOffset = n % (cycle.length + cycle.creates);
-	int ccsf = cycleCount * cycle.length;                          // Child cycle start frame
+// The engine is only accessed while holding the lock, since a bounded cycle cache may recycle
+// a cycle for another one as soon as the lock is released. Hence the copies.
+FrameMap SmoothSkip::getFrameMapping(IScriptEnvironment* env, int n, CycleSnapshot* snapshot) {
+	FrameMap map;
 
 	{
-		std::lock_guard<std::mutex> lockGuard(mutex);              // Ensure only one thread updates the frame map at a time to optimize disk I/O and Avisynth cache use.
-		if (!cycle.includes(ccsf)) {                               // Cycle stats have not been computed, so try to update the cycle.
-#ifdef DEBUG
-			printf("Frame %d not in cycle, updating!\n", n);
+		std::unique_lock<std::mutex> lock(mutex, std::defer_lock);  // Ensure only one thread updates the frame map at a time to optimize disk I/O and Avisynth cache use.
+		{
+			PerfTimer timer(&counters, PERF_LOCKS, PERF_LOCK_WAIT_NS);
+			TraceSpan span(trace.get(), TRACE_LOCK_WAIT, n);
+			lock.lock();
+		}
+#ifdef SMOOTHSKIP_BENCH
+		auto analysisStart = std::chrono::steady_clock::now();
+#endif
+		if (!engine->isAnalyzed(n)) {                              // Cycle stats have not been computed, so try to update the cycle.
+			ClipFrameSource source(child, env);
+			engine->analyze(source, n);
+#ifdef SMOOTHSKIP_BENCH
+			timings.analysisNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - analysisStart).count());
 #endif
-			updateCycle(env, ccsf, child->GetVideoInfo(), cycle);
 		}
+
+		map = engine->mapping(n, snapshot);
 	}
 
-	FrameMap map = cycle.frameMap[cycleOffset];
 	if (map.dstframe != n)
 		raiseError(env, "BUG! Frame counting is out of whack. Please report this to the author.");
 
 	return map;
 }
 
+void SmoothSkip::writeStats(const char* path) {
+	char name[256];
+	snprintf(name, sizeof(name), "SmoothSkip v%s stats, cycle %d, create %d, %d source frames", VERSION,
+		engine->length, engine->creates, child->GetVideoInfo().num_frames);
+	counters.write(path, name);
+}
+
 void raiseError(IScriptEnvironment* env, const char* msg) {
 	char buff[1024];
-	sprintf_s(buff, sizeof(buff), "[SmoothSkip] %s", msg);
+	snprintf(buff, sizeof(buff), "[SmoothSkip] %s", msg);
 	env->ThrowError(buff);
 }
@@ -18,39 +18,70 @@
 
 #pragma once
 
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
 #include "3rd-party/avisynth.h"
-#include "cycle.h"
-#include "CycleCache.h"
+#include "CycleEngine.h"
+#include "DebugLog.h"
+#include "EncoderHints.h"
 #include "FrameDiff.h"
+#include "PerfCounters.h"
+#include "Synth.h"
+#include "Trace.h"
 
 #define VERSION "2.0.1"
 
+#ifdef _WIN32
+#define SMOOTHSKIP_EXPORT __declspec(dllexport)
+#else
+#define SMOOTHSKIP_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef SMOOTHSKIP_BENCH
+// Timings for the benchmark harness in bench/, which builds the filter with SMOOTHSKIP_BENCH. Not in the plugin.
+struct BenchTimings {
+	std::vector<long long> analysisNs;      // duration of every cycle analysis, guarded by the filter mutex
+};
+#endif
+
 class SmoothSkip : public GenericVideoFilter {
-	PClip altclip;     // The super clip from MVTools2
+	PClip altclip;     // The super clip from MVTools2, only with SYNTH_ALTCLIP
+	SynthMode synth;   // synth arg, how inserted frames are made
+	int cpuFlags;      // for the synthesizers
 	bool debug;        // debug arg
 	int offset;        // frame offset used to get frame from the alternate clip.
-	std::mutex mutex;
+	int segmentStart;  // first frame of the full (unsegmented) output that this instance outputs as its frame 0
+	bool retime;       // mode="timecodes": the output is the source frames, retimed by the timecodes file
+	std::mutex mutex;  // guards engine
+	std::unique_ptr<CycleEngine> engine;       // cycle decisions of the child clip, see CycleEngine.h
+	std::string statsFile;                     // stats arg, where to write the counters on destruction
+	std::string traceFile;                     // trace arg, where to write the trace on destruction
+	std::unique_ptr<TraceRecorder> trace;      // only with a trace file, null otherwise
+	std::unique_ptr<EncoderHints> hints;       // only with a qpfile, zones or timecodes file, null otherwise
+	std::unique_ptr<DebugLog> debugLog;        // only with a debuglog file, null otherwise
 
 public:
-	CycleCache* cycles;
-	SmoothSkip(PClip _child, PClip _altclip, int cycleLen, int creates, int offset, 
-			   double sceneThreshold, bool _debug, IScriptEnvironment* env);
+	PerfCounters counters;
+#ifdef SMOOTHSKIP_BENCH
+	BenchTimings timings;
+#endif
+	SmoothSkip(PClip _child, PClip _altclip, SynthMode synth, int cycleLen, int creates, int dupes, int offset, 
+			   double sceneThreshold, double confidence, double staticFloor, bool _debug, CycleFactory cycleFactory, int cacheCycles, bool spill,
+			   int segmentStartFrame, int segmentEndFrame, const char* inputFile, const char* statsFile, const char* traceFile,
+			   const char* qpFile, const char* zonesFile, const char* zoneOptions, bool retime, const char* timecodesFile,
+			   const char* debugLogFile, IScriptEnvironment* env);
 	~SmoothSkip();
+	// Summary of the counters, "-" for stderr. Files are appended to.
+	void writeStats(const char* path);
 	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
 private:
-	void updateCycle(IScriptEnvironment* env, int n, VideoInfo cvi, Cycle& cycle);
-	PVideoFrame info(IScriptEnvironment* env, PVideoFrame src, char* msg, int x, int y);
-	float GetDiffFromPrevious(IScriptEnvironment* env, int n);
-	FrameMap SmoothSkip::getFrameMapping(IScriptEnvironment* env, int n);
+	void info(PVideoFrame& frame, const char* msg, int x, int y);
+	PVideoFrame synthesize(IScriptEnvironment* env, int n1, int n2, SynthMode mode);
+	FrameMap getFrameMapping(IScriptEnvironment* env, int n, CycleSnapshot* snapshot = nullptr);
 };
 
 AVSValue __cdecl Create_SmoothSkip(AVSValue args, void* user_data, IScriptEnvironment* env);
 
-const AVS_Linkage* AVS_linkage = 0;
-extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* env, const AVS_Linkage* const vectors) {
-	AVS_linkage = vectors;
-	env->AddFunction("SmoothSkip", "cc[CYCLE]i[CREATE]i[OFFSET]f[SCENE]i[DEBUG]b", Create_SmoothSkip, 0);
-	return "'SmoothSkip' plugin v" VERSION ", author: tinjon[at]gmail.com";
-}
-
-void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bIsYUY2);
+void DrawString(PVideoFrame &dst, int x, int y, const char *s, int bIsYUY2, int cpuFlags);
@@ -0,0 +1,428 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+// VapourSynth frontend of SmoothSkip, sharing the cycle logic and diff kernels with the AviSynth plugin.
+//
+// Unlike AviSynth's GetFrame, VapourSynth lets a filter declare the frames it needs before it runs.
+// An output frame whose cycle isn't analyzed yet requests the cycle's source frames and the frame
+// before it (cycle+1 frames) in one go, so the host renders them in parallel, and diffs them once
+// they are all ready. The alt clip frame is requested in a second round, once the cycle is classified,
+// so only the alt frames that actually get inserted are rendered. With synth="blend" or "motion" the
+// second round requests the two source frames around the skip instead, as it does for the inserted frames
+// of low confidence cycles, which are blended whatever the synth mode. Inserted frames of static cycles
+// are the source frame after the skip, passed on by reference. With mode="timecodes" the output is the
+// source frames, and each analyzed cycle only adds its frames' times to the timecodes file.
+//
+//   core.smoothskip.SmoothSkip(clip[, altclip, cycle=4, create=1, offset=0, scene=32.0, cache=0, stats="", trace="", synth="",
+//                              confidence=0.0, static=0.0, qpfile="", zones="", zone_options="b=0.75", mode="insert", timecodes="",
+//                              dupes=0])
+
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <VapourSynth4.h>
+#include <VSHelper4.h>
+#include "CycleEngine.h"
+#include "EncoderHints.h"
+#include "FixedCycle.h"
+#include "MotionInterp.h"
+#include "PlaneBlend.h"
+#include "PlaneDiff.h"
+#include "Synth.h"
+
+#define PLUGIN_VERSION VS_MAKE_VERSION(2, 0)
+
+// frameData slots, and the stages of an output frame kept in FD_STAGE
+enum { FD_STAGE, FD_FRAME };
+enum { STAGE_CYCLE = 1, STAGE_SOURCE, STAGE_ALT, STAGE_SYNTH, STAGE_BLEND, STAGE_REPEAT };
+
+struct SmoothSkipVS {
+	const VSAPI* vsapi;
+	VSNode* clip;
+	VSNode* altclip;         // only with SYNTH_ALTCLIP
+	SynthMode synth;
+	bool retime;             // mode="timecodes": the output is the source frames, retimed by the timecodes file
+	int cpuFlags;
+	VSVideoInfo vi;          // of the output
+	int clipFrames;
+	int altFrames;
+	int offset;              // frame offset used to get frame from the alternate clip
+	std::mutex mutex;        // guards engine
+	std::unique_ptr<CycleEngine> engine;
+	PerfCounters counters;   // frames are rendered asynchronously by the host, so frame fetches are only counted
+	std::string statsFile;   // stats arg, where to write the counters on destruction
+	std::string traceFile;   // trace arg, where to write the trace on destruction
+	std::unique_ptr<TraceRecorder> trace;   // only with a trace file, null otherwise
+	std::unique_ptr<EncoderHints> hints;    // only with a qpfile, zones or timecodes file, null otherwise
+
+	explicit SmoothSkipVS(const VSAPI* vsapi) : vsapi(vsapi), clip(nullptr), altclip(nullptr), synth(SYNTH_ALTCLIP), retime(false), cpuFlags(0) {}
+	~SmoothSkipVS() {
+		if (!statsFile.empty() && engine) {
+			std::string name = "SmoothSkip (VapourSynth) stats, cycle " + std::to_string(engine->length) +
+			                   ", create " + std::to_string(engine->creates) + ", " + std::to_string(clipFrames) + " source frames";
+			counters.write(statsFile.c_str(), name.c_str());
+		}
+		if (trace) {
+			trace->write(traceFile.c_str());
+		}
+		vsapi->freeNode(clip);
+		vsapi->freeNode(altclip);
+	}
+};
+
+static void* stageData(intptr_t value) {
+	return reinterpret_cast<void*>(value);
+}
+
+static int stageValue(void* data) {
+	return static_cast<int>(reinterpret_cast<intptr_t>(data));
+}
+
+// The source clip frames requested for a cycle, once they have all been rendered.
+class ReadyFrames : public FrameSource {
+	SmoothSkipVS* d;
+	VSFrameContext* frameCtx;
+
+public:
+	ReadyFrames(SmoothSkipVS* d, VSFrameContext* frameCtx) : d(d), frameCtx(frameCtx) {}
+
+	int frameCount() override {
+		return d->clipFrames;
+	}
+
+	PlaneView luma(int n) override {
+		const VSAPI* vsapi = d->vsapi;
+		const VSFrame* frame = vsapi->getFrameFilter(n, d->clip, frameCtx);
+		PlaneView view;
+		view.data = vsapi->getReadPtr(frame, 0);
+		view.pitch = static_cast<int>(vsapi->getStride(frame, 0));
+		view.rowSize = vsapi->getFrameWidth(frame, 0) * d->vi.format.bytesPerSample;
+		view.height = vsapi->getFrameHeight(frame, 0);
+		view.pixelSize = d->vi.format.bytesPerSample;
+		view.bits = d->vi.format.bitsPerSample;
+		view.frame = std::shared_ptr<const void>(frame, [vsapi](const void* f) { vsapi->freeFrame(static_cast<const VSFrame*>(f)); });
+		return view;
+	}
+};
+
+static std::unique_lock<std::mutex> lockEngine(SmoothSkipVS* d, int n) {
+	std::unique_lock<std::mutex> lock(d->mutex, std::defer_lock);
+	PerfTimer timer(&d->counters, PERF_LOCKS, PERF_LOCK_WAIT_NS);
+	TraceSpan span(d->trace.get(), TRACE_LOCK_WAIT, n);
+	lock.lock();
+	return lock;
+}
+
+// Mapping of output frame n, if its cycle has been analyzed.
+static bool lookupFrameMapping(SmoothSkipVS* d, int n, FrameMap& map) {
+	std::unique_lock<std::mutex> lock = lockEngine(d, n);
+	if (!d->engine->isAnalyzed(n)) return false;
+	map = d->engine->mapping(n);
+	return true;
+}
+
+// Analyzes the cycle with its diffs, unless another output frame of the cycle got there first,
+// and returns the mapping of output frame n.
+static FrameMap storeCycle(SmoothSkipVS* d, int n, const std::vector<float>& diffs) {
+	std::unique_lock<std::mutex> lock = lockEngine(d, n);
+	if (!d->engine->isAnalyzed(n)) d->engine->analyze(n, diffs.data());
+	return d->engine->mapping(n);
+}
+
+static void requestMapped(SmoothSkipVS* d, const FrameMap& map, void** frameData, VSFrameContext* frameCtx) {
+	if (map.altclip && map.staticCycle) {
+		frameData[FD_STAGE] = stageData(STAGE_REPEAT);
+		frameData[FD_FRAME] = stageData(map.srcframe);
+		d->vsapi->requestFrameFilter(map.srcframe, d->clip, frameCtx);
+	} else if (map.altclip && (map.lowConfidence || d->synth != SYNTH_ALTCLIP)) {
+		frameData[FD_STAGE] = stageData(map.lowConfidence ? STAGE_BLEND : STAGE_SYNTH);
+		frameData[FD_FRAME] = stageData(map.srcframe);
+		d->vsapi->requestFrameFilter(std::max(map.srcframe - 1, 0), d->clip, frameCtx);
+		d->vsapi->requestFrameFilter(map.srcframe, d->clip, frameCtx);
+	} else if (map.altclip) {
+		int acn = std::min(std::max(map.srcframe + d->offset, 0), d->altFrames - 1);
+		frameData[FD_STAGE] = stageData(STAGE_ALT);
+		frameData[FD_FRAME] = stageData(acn);
+		d->vsapi->requestFrameFilter(acn, d->altclip, frameCtx);
+	} else {
+		frameData[FD_STAGE] = stageData(STAGE_SOURCE);
+		frameData[FD_FRAME] = stageData(map.srcframe);
+		d->vsapi->requestFrameFilter(map.srcframe, d->clip, frameCtx);
+	}
+}
+
+// The output frame: src with the frame duration of the output clip, and tagged whether it was inserted.
+// Retimed frames keep the source duration, the timecodes file has the real one.
+static const VSFrame* outputFrame(SmoothSkipVS* d, const VSFrame* src, bool inserted, VSCore* core) {
+	const VSAPI* vsapi = d->vsapi;
+	VSFrame* dst = vsapi->copyFrame(src, core);
+	vsapi->freeFrame(src);
+	VSMap* props = vsapi->getFramePropertiesRW(dst);
+	if (d->vi.fpsNum > 0 && !d->retime) {
+		vsapi->mapSetInt(props, "_DurationNum", d->vi.fpsDen, maReplace);
+		vsapi->mapSetInt(props, "_DurationDen", d->vi.fpsNum, maReplace);
+	}
+	vsapi->mapSetInt(props, "SmoothSkipInserted", inserted ? 1 : 0, maReplace);
+	d->counters.add(inserted ? PERF_ALT_FRAMES : PERF_CHILD_FRAMES);
+	return dst;
+}
+
+// Frame halfway between the source frames before and after the skip at source frame n, in all planes,
+// made as mode, SYNTH_BLEND or SYNTH_MOTION, says.
+static const VSFrame* synthesizeFrame(SmoothSkipVS* d, int n, SynthMode mode, VSFrameContext* frameCtx, VSCore* core) {
+	const VSAPI* vsapi = d->vsapi;
+	const VSVideoFormat& format = d->vi.format;
+	const VSFrame* a = vsapi->getFrameFilter(std::max(n - 1, 0), d->clip, frameCtx);
+	const VSFrame* b = vsapi->getFrameFilter(n, d->clip, frameCtx);
+	VSFrame* dst = vsapi->newVideoFrame(&format, d->vi.width, d->vi.height, b, core);
+
+	MotionInterpolator motion(d->cpuFlags);
+	if (mode == SYNTH_MOTION) {
+		PlaneView prev = { vsapi->getReadPtr(a, 0), static_cast<int>(vsapi->getStride(a, 0)), d->vi.width * format.bytesPerSample,
+		                   d->vi.height, format.bytesPerSample, format.bitsPerSample, nullptr };
+		PlaneView next = prev;
+		next.data = vsapi->getReadPtr(b, 0);
+		next.pitch = static_cast<int>(vsapi->getStride(b, 0));
+		motion.estimate(prev, next);
+	}
+
+	for (int plane = 0; plane < format.numPlanes; plane++) {
+		uint8_t* dstp = vsapi->getWritePtr(dst, plane);
+		int dstPitch = static_cast<int>(vsapi->getStride(dst, plane));
+		int pitch = static_cast<int>(vsapi->getStride(a, plane)), pitch2 = static_cast<int>(vsapi->getStride(b, plane));
+		int rowSize = vsapi->getFrameWidth(dst, plane) * format.bytesPerSample, height = vsapi->getFrameHeight(dst, plane);
+		if (mode == SYNTH_MOTION) {
+			motion.compensate(dstp, dstPitch, vsapi->getReadPtr(a, plane), vsapi->getReadPtr(b, plane), pitch, pitch2,
+			                  rowSize, height, format.bytesPerSample, plane ? format.subSamplingW : 0, plane ? format.subSamplingH : 0);
+		} else {
+			PlaneBlend(dstp, dstPitch, vsapi->getReadPtr(a, plane), vsapi->getReadPtr(b, plane), pitch, pitch2,
+			           rowSize, height, format.bytesPerSample, d->cpuFlags);
+		}
+	}
+	vsapi->freeFrame(a);
+	vsapi->freeFrame(b);
+	return dst;
+}
+
+static const VSFrame* VS_CC smoothSkipGetFrame(int n, int activationReason, void* instanceData, void** frameData,
+                                               VSFrameContext* frameCtx, VSCore* core, const VSAPI* vsapi) {
+	SmoothSkipVS* d = static_cast<SmoothSkipVS*>(instanceData);
+	// Retimed, n is a source frame and the cycle is found by its first output frame.
+	const int on = d->retime ? n / d->engine->length * (d->engine->length + d->engine->creates) : n;
+
+	if (activationReason == arInitial) {
+		FrameMap map;
+		if (lookupFrameMapping(d, on, map)) {
+			if (d->retime) {
+				frameData[FD_STAGE] = stageData(STAGE_SOURCE);
+				frameData[FD_FRAME] = stageData(n);
+				vsapi->requestFrameFilter(n, d->clip, frameCtx);
+			} else {
+				requestMapped(d, map, frameData, frameCtx);
+			}
+		} else {
+			frameData[FD_STAGE] = stageData(STAGE_CYCLE);
+			for (int i = std::max(d->engine->cycleStart(on) - 1, 0); i <= d->engine->cycleEnd(on); i++) {
+				vsapi->requestFrameFilter(i, d->clip, frameCtx);
+			}
+		}
+		return nullptr;
+	}
+	if (activationReason != arAllFramesReady) return nullptr;
+
+	const int stage = stageValue(frameData[FD_STAGE]);
+	if (stage == STAGE_SYNTH || stage == STAGE_BLEND) {
+		SynthMode mode = stage == STAGE_BLEND ? SYNTH_BLEND : d->synth;
+		if (mode != d->synth) d->counters.add(PERF_LOW_CONFIDENCE);
+		return outputFrame(d, synthesizeFrame(d, stageValue(frameData[FD_FRAME]), mode, frameCtx, core), true, core);
+	}
+	if (stage != STAGE_CYCLE) {
+		VSNode* node = stage == STAGE_ALT ? d->altclip : d->clip;
+		if (stage == STAGE_REPEAT) d->counters.add(PERF_STATIC_REPEATS);
+		return outputFrame(d, vsapi->getFrameFilter(stageValue(frameData[FD_FRAME]), node, frameCtx),
+		                   stage == STAGE_ALT || stage == STAGE_REPEAT, core);
+	}
+
+	// The diffs are computed outside the lock, so that cycles are analyzed in parallel.
+	std::vector<float> diffs(d->engine->length);
+	ReadyFrames source(d, frameCtx);
+	{
+		TraceSpan span(d->trace.get(), TRACE_ANALYZE, d->engine->cycleStart(on));
+		d->engine->cycleDiffs(source, on, diffs.data());
+	}
+
+	FrameMap map = storeCycle(d, on, diffs);
+	if (map.dstframe != on) {
+		vsapi->setFilterError("SmoothSkip: BUG! Frame counting is out of whack. Please report this to the author.", frameCtx);
+		return nullptr;
+	}
+	if (d->retime) {                                               // source frame n was requested with the cycle
+		return outputFrame(d, vsapi->getFrameFilter(n, d->clip, frameCtx), false, core);
+	}
+	if (!map.altclip || map.staticCycle) {                         // the source frame was requested with the cycle
+		if (map.staticCycle) d->counters.add(PERF_STATIC_REPEATS);
+		return outputFrame(d, vsapi->getFrameFilter(map.srcframe, d->clip, frameCtx), map.altclip, core);
+	}
+	requestMapped(d, map, frameData, frameCtx);
+	return nullptr;
+}
+
+static void VS_CC smoothSkipFree(void* instanceData, VSCore*, const VSAPI*) {
+	delete static_cast<SmoothSkipVS*>(instanceData);
+}
+
+static bool isSupportedFormat(const VSVideoInfo* vi) {
+	const VSVideoFormat& f = vi->format;
+	return vsh::isConstantVideoFormat(vi) &&
+	       (f.colorFamily == cfGray || f.colorFamily == cfYUV) &&
+	       ((f.sampleType == stInteger && f.bitsPerSample <= 16) || (f.sampleType == stFloat && f.bitsPerSample == 32));
+}
+
+static void VS_CC smoothSkipCreate(const VSMap* in, VSMap* out, void*, VSCore* core, const VSAPI* vsapi) {
+	std::unique_ptr<SmoothSkipVS> d(new SmoothSkipVS(vsapi));
+	int err;
+
+	d->clip = vsapi->mapGetNode(in, "clip", 0, nullptr);
+	d->altclip = vsapi->mapGetNode(in, "altclip", 0, &err);
+	const char* synth = vsapi->mapGetData(in, "synth", 0, &err);
+	if (err) synth = d->altclip ? "altclip" : "blend";
+	if (!parseSynthMode(synth, d->synth)) {
+		vsapi->mapSetError(out, "SmoothSkip: Synth must be \"altclip\", \"blend\" or \"motion\"");
+		return;
+	}
+	const char* mode = vsapi->mapGetData(in, "mode", 0, &err);
+	if (err) mode = "insert";
+	d->retime = !strcmp(mode, "timecodes");
+	if (!d->retime && strcmp(mode, "insert")) {
+		vsapi->mapSetError(out, "SmoothSkip: Mode must be \"insert\" or \"timecodes\"");
+		return;
+	}
+	if (d->synth != SYNTH_ALTCLIP || d->retime) {                // not a dependency when unused
+		vsapi->freeNode(d->altclip);
+		d->altclip = nullptr;
+	}
+	const VSVideoInfo* cvi = vsapi->getVideoInfo(d->clip);
+	const VSVideoInfo* avi = d->altclip ? vsapi->getVideoInfo(d->altclip) : nullptr;
+
+	int cycleLen = vsapi->mapGetIntSaturated(in, "cycle", 0, &err);
+	if (err) cycleLen = 4;
+	int creates = vsapi->mapGetIntSaturated(in, "create", 0, &err);
+	if (err) creates = 1;
+	int dupes = vsapi->mapGetIntSaturated(in, "dupes", 0, &err);
+	if (err) dupes = 0;
+	d->offset = vsapi->mapGetIntSaturated(in, "offset", 0, &err);
+	if (err) d->offset = 0;
+	double sceneThresh = vsapi->mapGetFloat(in, "scene", 0, &err);
+	if (err) sceneThresh = 32;
+	double confidence = vsapi->mapGetFloat(in, "confidence", 0, &err);
+	if (err) confidence = 0;
+	double staticFloor = vsapi->mapGetFloat(in, "static", 0, &err);
+	if (err) staticFloor = 0;
+	int cacheCycles = vsapi->mapGetIntSaturated(in, "cache", 0, &err);
+	if (err) cacheCycles = 0;
+	const char* stats = vsapi->mapGetData(in, "stats", 0, &err);
+	if (!err) d->statsFile = stats;
+	const char* trace = vsapi->mapGetData(in, "trace", 0, &err);
+	if (!err) d->traceFile = trace;
+	const char* qpfile = vsapi->mapGetData(in, "qpfile", 0, &err);
+	if (err) qpfile = "";
+	const char* zones = vsapi->mapGetData(in, "zones", 0, &err);
+	if (err) zones = "";
+	const char* zoneOptions = vsapi->mapGetData(in, "zone_options", 0, &err);
+	if (err) zoneOptions = "b=0.75";
+	const char* timecodes = vsapi->mapGetData(in, "timecodes", 0, &err);
+	if (err) timecodes = "";
+
+	const char* error = nullptr;
+	if (!isSupportedFormat(cvi)) error = "Input clip must be constant format Gray or YUV, 8-16 bit integer or 32 bit float";
+	else if (d->synth == SYNTH_ALTCLIP && !avi && !d->retime) error = "Alternate clip is required with synth=\"altclip\"";
+	else if (avi && (!vsh::isSameVideoFormat(&cvi->format, &avi->format) || cvi->width != avi->width || cvi->height != avi->height))
+		error = "Alternate clip must have the same format and frame size as the input clip";
+	else if (cycleLen < 1) error = "Cycle must be > 0";
+	else if (cycleLen > cvi->numFrames) error = "Cycle can't be larger than the frames in source clip";
+	else if (avi && cycleLen > avi->numFrames) error = "Cycle can't be larger than the frames in alt clip";
+	else if (creates < 1 || creates > cycleLen) error = "Create must be between 1 and the value of cycle (1 <= create <= cycle)";
+	else if (dupes < 0 || dupes > cycleLen - creates) error = "Dupes must be between 0 and cycle - create (0 <= dupes <= cycle - create)";
+	else if (sceneThresh < 0) error = "Scene threshold must be >= 0.0";
+	else if (confidence < 0) error = "Confidence must be >= 0.0";
+	else if (staticFloor < 0) error = "Static noise floor must be >= 0.0";
+	else if (cacheCycles < 0) error = "Cache must be >= 0";
+	else if (d->retime && cvi->fpsNum <= 0) error = "Mode \"timecodes\" needs a clip with a constant frame rate";
+	else if (d->retime && !*timecodes) error = "Mode \"timecodes\" needs a timecodes file";
+	else if (d->retime && dupes > 0) error = "Mode \"timecodes\" can't drop dupes";
+	else if (!d->retime && *timecodes) error = "A timecodes file is only written with mode=\"timecodes\"";
+	if (error) {
+		vsapi->mapSetError(out, (std::string("SmoothSkip: ") + error).c_str());
+		return;
+	}
+
+	d->clipFrames = cvi->numFrames;
+	d->altFrames = avi ? avi->numFrames : 0;
+	d->cpuFlags = DetectCPUFlags();
+	try {
+		d->engine.reset(new CycleEngine(d->clipFrames, cycleLen, creates, dupes, static_cast<float>(sceneThresh),
+		                                selectCycleFactory(cycleLen, creates, dupes), d->cpuFlags, cacheCycles));
+		d->engine->setCounters(&d->counters);
+		d->engine->setConfidence(static_cast<float>(confidence));
+		d->engine->setStaticFloor(static_cast<float>(staticFloor));
+		if (!d->traceFile.empty()) {
+			d->trace.reset(new TraceRecorder());
+			d->engine->setTrace(d->trace.get());
+		}
+	}
+	catch (std::bad_alloc&) {
+		vsapi->mapSetError(out, "SmoothSkip: Failed to allocate cycle memory");
+		return;
+	}
+	if (*qpfile || *zones || d->retime) {
+		double frameMs = cvi->fpsNum > 0 ? 1000.0 * cvi->fpsDen * cycleLen / ((double)cvi->fpsNum * (cycleLen + creates)) : 0;
+		try {
+			d->hints.reset(new EncoderHints(qpfile, zones, zoneOptions, timecodes, frameMs, cycleLen, 0, (cvi->numFrames - 1) / cycleLen));
+		}
+		catch (std::runtime_error& e) {
+			vsapi->mapSetError(out, (std::string("SmoothSkip: ") + e.what()).c_str());
+			return;
+		}
+		d->engine->setHints(d->hints.get());
+	}
+
+	d->vi = *cvi;
+	if (!d->retime) d->vi.numFrames = d->engine->outputFrameCount();
+	if (d->vi.fpsNum > 0 && !d->retime) {
+		vsh::muldivRational(&d->vi.fpsNum, &d->vi.fpsDen, cycleLen + creates - dupes, cycleLen);
+	}
+
+	VSFilterDependency deps[] = { { d->clip, rpGeneral }, { d->altclip, rpGeneral } };
+	SmoothSkipVS* instance = d.release();
+	vsapi->createVideoFilter(out, "SmoothSkip", &instance->vi, smoothSkipGetFrame, smoothSkipFree, fmParallel, deps,
+	                         instance->altclip ? 2 : 1, instance, core);
+}
+
+VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin* plugin, const VSPLUGINAPI* vspapi) {
+	vspapi->configPlugin("com.tinjon.smoothskip", "smoothskip", "Inserts frames from another clip at the skips of stuttering clips",
+	                     PLUGIN_VERSION, VAPOURSYNTH_API_VERSION, 0, plugin);
+	vspapi->registerFunction("SmoothSkip",
+	                         "clip:vnode;altclip:vnode:opt;cycle:int:opt;create:int:opt;offset:int:opt;scene:float:opt;cache:int:opt;stats:data:opt;trace:data:opt;synth:data:opt;confidence:float:opt;static:float:opt;qpfile:data:opt;zones:data:opt;zone_options:data:opt;mode:data:opt;timecodes:data:opt;dupes:int:opt;",
+	                         "clip:vnode;", smoothSkipCreate, nullptr, plugin);
+}
@@ -0,0 +1,38 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <string.h>
+
+// Where the frames inserted at the skips come from, the synth option of the filters.
+enum SynthMode {
+	SYNTH_ALTCLIP,   // the alt clip's frame, e.g. from MVTools' MFlowInter
+	SYNTH_BLEND,     // per pixel mean of the source frames before and after the skip, see PlaneBlend.h
+	SYNTH_MOTION     // motion compensated frame halfway between them, see MotionInterp.h
+};
+
+// The mode of a synth option value. False if there is no such mode.
+inline bool parseSynthMode(const char* name, SynthMode& mode) {
+	if (!strcmp(name, "altclip")) mode = SYNTH_ALTCLIP;
+	else if (!strcmp(name, "blend")) mode = SYNTH_BLEND;
+	else if (!strcmp(name, "motion")) mode = SYNTH_MOTION;
+	else return false;
+	return true;
+}
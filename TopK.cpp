@@ -0,0 +1,119 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <limits>
+#include "TopK.h"
+
+#define BATCH_LANES 4
+
+void selectTopK(CycleDiff* diffs, int n, int k) {
+	switch (n) {
+	case 2:  sortNetwork<2>(diffs);  return;
+	case 3:  sortNetwork<3>(diffs);  return;
+	case 4:  sortNetwork<4>(diffs);  return;
+	case 5:  sortNetwork<5>(diffs);  return;
+	case 6:  sortNetwork<6>(diffs);  return;
+	case 7:  sortNetwork<7>(diffs);  return;
+	case 8:  sortNetwork<8>(diffs);  return;
+	case 9:  sortNetwork<9>(diffs);  return;
+	case 10: sortNetwork<10>(diffs); return;
+	case 11: sortNetwork<11>(diffs); return;
+	case 12: sortNetwork<12>(diffs); return;
+	}
+	if (n < TOPK_NETWORK_MIN) return;
+	k = std::min(k, n);
+	std::partial_sort(diffs, diffs + k, diffs + n, rankedBefore);
+}
+
+// Compare-exchange of the same two positions in four cycles at once, one cycle per lane.
+struct BatchExchange {
+	__m128  diff[TOPK_NETWORK_MAX];
+	__m128i frame[TOPK_NETWORK_MAX];
+
+	template<int I, int J>
+	void apply() {
+		// swap lanes where J ranks before I: larger diff, or equal diff and lower frame number
+		__m128 gt = _mm_cmpgt_ps(diff[J], diff[I]);
+		__m128 eq = _mm_cmpeq_ps(diff[J], diff[I]);
+		__m128 lo = _mm_castsi128_ps(_mm_cmplt_epi32(frame[J], frame[I]));
+		__m128 swap = _mm_or_ps(gt, _mm_and_ps(eq, lo));
+		__m128i swapi = _mm_castps_si128(swap);
+
+		__m128 di = _mm_or_ps(_mm_and_ps(swap, diff[J]), _mm_andnot_ps(swap, diff[I]));
+		__m128 dj = _mm_or_ps(_mm_and_ps(swap, diff[I]), _mm_andnot_ps(swap, diff[J]));
+		__m128i fi = _mm_or_si128(_mm_and_si128(swapi, frame[J]), _mm_andnot_si128(swapi, frame[I]));
+		__m128i fj = _mm_or_si128(_mm_and_si128(swapi, frame[I]), _mm_andnot_si128(swapi, frame[J]));
+		diff[I] = di;
+		diff[J] = dj;
+		frame[I] = fi;
+		frame[J] = fj;
+	}
+};
+
+template<int N>
+static void sortBatchNetwork(CycleDiff* const* sets, int count) {
+	alignas(16) float diffs[BATCH_LANES];
+	alignas(16) int frames[BATCH_LANES];
+	BatchExchange x;
+
+	for (int base = 0; base < count; base += BATCH_LANES) {
+		int lanes = std::min(BATCH_LANES, count - base);
+
+		// transpose the sets into lane-per-set order, padding unused lanes
+		for (int i = 0; i < N; i++) {
+			for (int l = 0; l < BATCH_LANES; l++) {
+				diffs[l] = l < lanes ? sets[base + l][i].diff : -std::numeric_limits<float>::max();
+				frames[l] = l < lanes ? sets[base + l][i].frame : -1;
+			}
+			x.diff[i] = _mm_load_ps(diffs);
+			x.frame[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(frames));
+		}
+
+		BoseNelsonSort<BatchExchange, 0, N>::run(x);
+
+		for (int i = 0; i < N; i++) {
+			_mm_store_ps(diffs, x.diff[i]);
+			_mm_store_si128(reinterpret_cast<__m128i*>(frames), x.frame[i]);
+			for (int l = 0; l < lanes; l++) {
+				sets[base + l][i].diff = diffs[l];
+				sets[base + l][i].frame = frames[l];
+			}
+		}
+	}
+}
+
+void sortTopKBatch(CycleDiff* const* sets, int count, int n) {
+	switch (n) {
+	case 2:  sortBatchNetwork<2>(sets, count);  return;
+	case 3:  sortBatchNetwork<3>(sets, count);  return;
+	case 4:  sortBatchNetwork<4>(sets, count);  return;
+	case 5:  sortBatchNetwork<5>(sets, count);  return;
+	case 6:  sortBatchNetwork<6>(sets, count);  return;
+	case 7:  sortBatchNetwork<7>(sets, count);  return;
+	case 8:  sortBatchNetwork<8>(sets, count);  return;
+	case 9:  sortBatchNetwork<9>(sets, count);  return;
+	case 10: sortBatchNetwork<10>(sets, count); return;
+	case 11: sortBatchNetwork<11>(sets, count); return;
+	case 12: sortBatchNetwork<12>(sets, count); return;
+	}
+	for (int i = 0; i < count; i++) {
+		selectTopK(sets[i], n, n);
+	}
+}
@@ -0,0 +1,140 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include "Cycle.h"
+
+// Shortest cycle length handled by the fixed sorting networks.
+#define TOPK_NETWORK_MIN 2
+// Longest cycle length handled by the fixed sorting networks. Longer cycles use partial selection.
+#define TOPK_NETWORK_MAX 12
+
+/**
+ * Ranking order of cycle diffs: largest diff first. Equal diffs are ordered by frame number
+ * so that the ranking is deterministic, which qsort never guaranteed.
+ */
+inline bool rankedBefore(const CycleDiff& a, const CycleDiff& b) {
+	return a.diff > b.diff || (a.diff == b.diff && a.frame < b.frame);
+}
+
+// ==========================================================================
+// Bose-Nelson sorting networks, generated at compile time.
+// The Exchange type provides "template<int I, int J> void apply()", which must
+// leave the element ranked first at position I.
+// ==========================================================================
+
+// Merges the sorted ranges [I, I+X) and [J, J+Y)
+template<class Exchange, int I, int X, int J, int Y>
+struct BoseNelsonMerge {
+	static void run(Exchange& x) {
+		const int A = X / 2;
+		const int B = (X & 1) ? (Y / 2) : ((Y + 1) / 2);
+		BoseNelsonMerge<Exchange, I, A, J, B>::run(x);
+		BoseNelsonMerge<Exchange, I + A, X - A, J + B, Y - B>::run(x);
+		BoseNelsonMerge<Exchange, I + A, X - A, J, B>::run(x);
+	}
+};
+
+template<class Exchange, int I, int J, int Y>
+struct BoseNelsonMerge<Exchange, I, 0, J, Y> {
+	static void run(Exchange&) {}
+};
+
+template<class Exchange, int I, int X, int J>
+struct BoseNelsonMerge<Exchange, I, X, J, 0> {
+	static void run(Exchange&) {}
+};
+
+template<class Exchange, int I, int J>
+struct BoseNelsonMerge<Exchange, I, 0, J, 0> {
+	static void run(Exchange&) {}
+};
+
+template<class Exchange, int I, int J>
+struct BoseNelsonMerge<Exchange, I, 1, J, 1> {
+	static void run(Exchange& x) {
+		x.template apply<I, J>();
+	}
+};
+
+template<class Exchange, int I, int J>
+struct BoseNelsonMerge<Exchange, I, 1, J, 2> {
+	static void run(Exchange& x) {
+		x.template apply<I, J + 1>();
+		x.template apply<I, J>();
+	}
+};
+
+template<class Exchange, int I, int J>
+struct BoseNelsonMerge<Exchange, I, 2, J, 1> {
+	static void run(Exchange& x) {
+		x.template apply<I, J>();
+		x.template apply<I + 1, J>();
+	}
+};
+
+// Sorts the range [I, I+M)
+template<class Exchange, int I, int M>
+struct BoseNelsonSort {
+	static void run(Exchange& x) {
+		const int A = M / 2;
+		BoseNelsonSort<Exchange, I, A>::run(x);
+		BoseNelsonSort<Exchange, I + A, M - A>::run(x);
+		BoseNelsonMerge<Exchange, I, A, I + A, M - A>::run(x);
+	}
+};
+
+template<class Exchange, int I>
+struct BoseNelsonSort<Exchange, I, 1> {
+	static void run(Exchange&) {}
+};
+
+template<class Exchange, int I>
+struct BoseNelsonSort<Exchange, I, 0> {
+	static void run(Exchange&) {}
+};
+
+// Compare-exchange of two diffs in one cycle.
+struct DiffExchange {
+	CycleDiff* d;
+
+	template<int I, int J>
+	void apply() {
+		if (rankedBefore(d[J], d[I])) {
+			CycleDiff t = d[I];
+			d[I] = d[J];
+			d[J] = t;
+		}
+	}
+};
+
+// Fully sorts N diffs into ranking order using a fixed sorting network.
+template<int N>
+inline void sortNetwork(CycleDiff* diffs) {
+	DiffExchange x = { diffs };
+	BoseNelsonSort<DiffExchange, 0, N>::run(x);
+}
+
+// Puts the top k of the n diffs, in ranking order, at the start of the array.
+// Remaining elements end up in unspecified order.
+void selectTopK(CycleDiff* diffs, int n, int k);
+
+// Fully ranks count independent sets of n diffs each. Sets are processed four at a time
+// with SSE2, lane per set, when n is covered by the sorting networks. Needs SSE2, see Cycle::rankBatch.
+void sortTopKBatch(CycleDiff* const* sets, int count, int n);
@@ -0,0 +1,89 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include "Trace.h"
+
+static const char* eventNames[TRACE_EVENT_TYPES] = {
+	"GetFrame", "analyze cycle", "diff", "lock wait", "source GetFrame", "inserted frame"
+};
+
+static uint64_t nextRecorderId() {
+	static std::atomic<uint64_t> next(1);
+	return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+TraceRecorder::TraceRecorder() : id(nextRecorderId()), origin(std::chrono::steady_clock::now()) {
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::threadBuffer() {
+	// The buffer of the recorder this thread last recorded to. A single slot per thread, so that nothing is left
+	// behind in the threads' storage when a recorder is freed; recording to another recorder looks its buffer up again.
+	struct Slot {
+		uint64_t recorder;
+		ThreadBuffer* buffer;
+	};
+	thread_local Slot slot = { 0, nullptr };
+	if (slot.recorder == id) return *slot.buffer;
+
+	std::lock_guard<std::mutex> lockGuard(mutex);
+	std::thread::id self = std::this_thread::get_id();
+	auto it = std::find_if(buffers.begin(), buffers.end(), [&](const std::unique_ptr<ThreadBuffer>& b) { return b->owner == self; });
+	if (it == buffers.end()) {
+		buffers.emplace_back(new ThreadBuffer());
+		it = buffers.end() - 1;
+		(*it)->owner = self;
+		(*it)->thread = static_cast<int>(buffers.size());
+		(*it)->dropped = 0;
+		(*it)->events.reserve(4096);
+	}
+	slot = { id, it->get() };
+	return *slot.buffer;
+}
+
+void TraceRecorder::record(TraceEventType type, int frame, int64_t begin, int64_t end) {
+	ThreadBuffer& buffer = threadBuffer();
+	if (buffer.events.size() >= TRACE_MAX_EVENTS_PER_THREAD) {
+		buffer.dropped++;
+		return;
+	}
+	buffer.events.push_back({ type, frame, begin, end });
+}
+
+bool TraceRecorder::write(const char* path) {
+	FILE* f = fopen(path, "w");
+	if (!f) return false;
+
+	std::lock_guard<std::mutex> lockGuard(mutex);
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"SmoothSkip\"}}");
+	for (const auto& buffer : buffers) {
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d", buffer->thread, buffer->thread);
+		if (buffer->dropped) fprintf(f, " (%llu events dropped)", (unsigned long long)buffer->dropped);
+		fprintf(f, "\"}}");
+		for (const Event& e : buffer->events) {
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"smoothskip\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+				eventNames[e.type], buffer->thread, e.begin / 1e3, (e.end - e.begin) / 1e3, e.frame);
+		}
+	}
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
@@ -0,0 +1,103 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum TraceEventType {
+	TRACE_FRAME,          // output frame requested from the filter
+	TRACE_ANALYZE,        // analysis of a cycle, including its diffs
+	TRACE_DIFF,           // diff of a frame to its predecessor, including fetching both
+	TRACE_LOCK_WAIT,      // waiting for the instance lock
+	TRACE_CHILD_FRAME,    // output frame fetched from the source clip
+	TRACE_ALT_FRAME,      // inserted output frame, fetched from the alt clip or synthesized
+	TRACE_EVENT_TYPES
+};
+
+// Events kept per thread, about 24 MB. Later events are dropped, and the drops noted in the trace.
+#define TRACE_MAX_EVENTS_PER_THREAD (1 << 20)
+
+/**
+ * Opt-in timeline of what each thread of a filter instance spends its time on, written as a
+ * Chrome trace (chrome://tracing, ui.perfetto.dev) when the instance is done.
+ *
+ * Every thread records into its own buffer, without locking; the instance's lock is only
+ * taken when a thread records to it first, or after recording to another instance. Reading
+ * the buffers (write) must wait until no thread records anymore.
+ */
+class TraceRecorder {
+	struct Event {
+		int type;
+		int frame;
+		int64_t begin;   // ns since the recorder was created
+		int64_t end;
+	};
+
+	struct ThreadBuffer {
+		std::thread::id owner;
+		int thread;
+		uint64_t dropped;
+		std::vector<Event> events;
+	};
+
+	const uint64_t id;   // identifies the recorder in the threads' buffer slots, unlike its address never reused
+	const std::chrono::steady_clock::time_point origin;
+	std::mutex mutex;    // guards buffers
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	ThreadBuffer& threadBuffer();
+
+public:
+	TraceRecorder();
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	void record(TraceEventType type, int frame, int64_t begin, int64_t end);
+
+	// Overwrites the file. False if it can't be written.
+	bool write(const char* path);
+};
+
+/**
+ * Records an event from construction to destruction. Does nothing if trace is null.
+ */
+class TraceSpan {
+	TraceRecorder* trace;
+	TraceEventType type;
+	int frame;
+	int64_t begin;
+
+public:
+	TraceSpan(TraceRecorder* trace, TraceEventType type, int frame) : trace(trace), type(type), frame(frame) {
+		begin = trace ? trace->now() : 0;
+	}
+	~TraceSpan() {
+		if (trace) trace->record(type, frame, begin, trace->now());
+	}
+};
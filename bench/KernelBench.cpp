@@ -0,0 +1,212 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Microbenchmark of the SAD kernels in FrameDiffKernels.h.
+//
+// Runs every kernel over every pixel type, plane alignment and resolution it supports, reports
+// GB/s (bytes read from both planes) and TSC cycles per pixel, and checks each result against
+// get_sad_c. Exits non-zero on a mismatch, so it doubles as a smoke test of new kernels.
+//
+//   smoothskip_kernel_bench [--min-ms 200] [--filter <text in the row>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include "FrameDiffKernels.h"
+
+struct Resolution {
+	const char* name;
+	int width, height;
+};
+
+static const Resolution resolutions[] = {
+	{ "480p",  854,  480 },
+	{ "720p",  1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "1440p", 2560, 1440 },
+	{ "2160p", 3840, 2160 },
+	{ "4320p", 7680, 4320 },
+};
+
+enum PixelType { PIXEL_8, PIXEL_16, PIXEL_FLOAT };
+
+static const char* pixelTypeName[] = { "8-bit", "16-bit", "float" };
+static const int pixelTypeSize[] = { 1, 2, 4 };
+
+// Two planes of the same geometry. Unaligned planes start one pixel past a 64 byte boundary and
+// have a pitch that is not a multiple of 16, which is what the aligned-only kernels reject.
+struct PlanePair {
+	std::vector<BYTE> storage[2];
+	const BYTE* plane[2];
+	int rowsize, height, pitch;
+
+	PlanePair(PixelType type, const Resolution& res, bool aligned, std::mt19937& rng) {
+		int pixelSize = pixelTypeSize[type];
+		rowsize = res.width * pixelSize;
+		height = res.height;
+		pitch = aligned ? (rowsize + 63) / 64 * 64 : rowsize + 3 * pixelSize;
+		int skew = aligned ? 0 : pixelSize;
+
+		for (int i = 0; i < 2; i++) {
+			storage[i].resize(size_t(pitch) * height + 128);
+			BYTE* base = storage[i].data() + (64 - (uintptr_t)storage[i].data() % 64) % 64 + skew;
+			plane[i] = base;
+		}
+
+		// the second plane is the first with small random changes, like consecutive video frames
+		std::uniform_int_distribution<int> value(0, 255), delta(-12, 12);
+		for (int y = 0; y < height; y++) {
+			BYTE* a = const_cast<BYTE*>(plane[0]) + size_t(y) * pitch;
+			BYTE* b = const_cast<BYTE*>(plane[1]) + size_t(y) * pitch;
+			for (int x = 0; x < res.width; x++) {
+				int v = value(rng), d = delta(rng);
+				switch (type) {
+				case PIXEL_8:
+					a[x] = BYTE(v);
+					b[x] = BYTE(std::min(255, std::max(0, v + d)));
+					break;
+				case PIXEL_16:
+					reinterpret_cast<uint16_t*>(a)[x] = uint16_t(v << 8 | v);
+					reinterpret_cast<uint16_t*>(b)[x] = uint16_t(std::min(65535, std::max(0, (v << 8 | v) + d * 257)));
+					break;
+				case PIXEL_FLOAT:
+					reinterpret_cast<float*>(a)[x] = v / 255.0f;
+					reinterpret_cast<float*>(b)[x] = (v + d) / 255.0f;
+					break;
+				}
+			}
+		}
+	}
+
+	double reference(PixelType type) const {
+		int width = rowsize / pixelTypeSize[type];
+		switch (type) {
+		case PIXEL_8:  return get_sad_c<uint8_t>(plane[0], plane[1], height, width, pitch, pitch);
+		case PIXEL_16: return get_sad_c<uint16_t>(plane[0], plane[1], height, width, pitch, pitch);
+		default:       return get_sad_c<float>(plane[0], plane[1], height, width, pitch, pitch);
+		}
+	}
+};
+
+struct Kernel {
+	const char* name;
+	PixelType type;
+	bool needsAlignment;
+	bool needs32BitSum;
+	double (*run)(const PlanePair& p);
+};
+
+static double run_c_8(const PlanePair& p) { return get_sad_c<uint8_t>(p.plane[0], p.plane[1], p.height, p.rowsize, p.pitch, p.pitch); }
+static double run_c_16(const PlanePair& p) { return get_sad_c<uint16_t>(p.plane[0], p.plane[1], p.height, p.rowsize / 2, p.pitch, p.pitch); }
+static double run_c_float(const PlanePair& p) { return get_sad_c<float>(p.plane[0], p.plane[1], p.height, p.rowsize / 4, p.pitch, p.pitch); }
+static double run_sse2_8(const PlanePair& p) { return (double)calculate_sad_8_or_16_sse2<uint8_t, false>(p.plane[0], p.plane[1], p.pitch, p.pitch, p.rowsize, p.height); }
+static double run_sse2_16(const PlanePair& p) { return (double)calculate_sad_8_or_16_sse2<uint16_t, false>(p.plane[0], p.plane[1], p.pitch, p.pitch, p.rowsize, p.height); }
+static double run_sse2u_8(const PlanePair& p) { return (double)calculate_sad_8_or_16_sse2<uint8_t, false, false>(p.plane[0], p.plane[1], p.pitch, p.pitch, p.rowsize, p.height); }
+static double run_sse2u_16(const PlanePair& p) { return (double)calculate_sad_8_or_16_sse2<uint16_t, false, false>(p.plane[0], p.plane[1], p.pitch, p.pitch, p.rowsize, p.height); }
+#ifdef X86_32
+static double run_isse_8(const PlanePair& p) { return (double)get_sad_isse(p.plane[0], p.plane[1], p.height, p.rowsize, p.pitch, p.pitch); }
+#endif
+
+static const Kernel kernels[] = {
+	{ "c",    PIXEL_8,     false, false, run_c_8 },
+	{ "c",    PIXEL_16,    false, false, run_c_16 },
+	{ "c",    PIXEL_FLOAT, false, false, run_c_float },
+#ifdef X86_32
+	{ "isse", PIXEL_8,     false, true,  run_isse_8 },
+#endif
+	{ "sse2", PIXEL_8,     true,  false, run_sse2_8 },
+	{ "sse2", PIXEL_16,    true,  false, run_sse2_16 },
+	{ "sse2u", PIXEL_8,    false, false, run_sse2u_8 },
+	{ "sse2u", PIXEL_16,   false, false, run_sse2u_16 },
+};
+
+int main(int argc, char** argv) {
+	double minSeconds = 0.2;
+	const char* filter = nullptr;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--min-ms")) minSeconds = atof(argv[i + 1]) / 1000;
+		else if (!strcmp(argv[i], "--filter")) filter = argv[i + 1];
+		else {
+			fprintf(stderr, "usage: smoothskip_kernel_bench [--min-ms N] [--filter text]\n");
+			return 2;
+		}
+	}
+
+	std::mt19937 rng(1);
+	int failures = 0;
+	printf("%-6s %-7s %-9s %-6s %10s %10s  %s\n", "kernel", "pixel", "planes", "res", "GB/s", "cycles/px", "check");
+
+	for (PixelType type : { PIXEL_8, PIXEL_16, PIXEL_FLOAT }) {
+		for (bool aligned : { true, false }) {
+			for (const Resolution& res : resolutions) {
+				PlanePair planes(type, res, aligned, rng);
+				double expected = planes.reference(type);
+				double pixels = double(res.width) * res.height;
+				// worst case 8 bit sum, as checked by the dispatcher before picking the 32 bit ISSE kernel
+				bool sumFits32 = pixels * 255 <= 2147483647.0;
+
+				for (const Kernel& k : kernels) {
+					if (k.type != type) continue;
+					char row[128];
+					snprintf(row, sizeof(row), "%-6s %-7s %-9s %-6s", k.name, pixelTypeName[type], aligned ? "aligned" : "unaligned", res.name);
+					if (filter && !strstr(row, filter)) continue;
+					if ((k.needsAlignment && !aligned) || (k.needs32BitSum && !sumFits32)) {
+						printf("%s %10s %10s  unsupported\n", row, "-", "-");
+						continue;
+					}
+
+					double result = 0;
+					int iterations = 0;
+					unsigned long long cycles = 0;
+					auto start = std::chrono::steady_clock::now();
+					double elapsed;
+					do {
+						unsigned long long t0 = __rdtsc();
+						result = k.run(planes);
+						cycles += __rdtsc() - t0;
+						iterations++;
+						elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					} while (elapsed < minSeconds);
+
+					// integer sums are exact, the float kernels may only differ by summation order
+					bool ok = type == PIXEL_FLOAT ? std::abs(result - expected) <= 1e-6 * std::max(1.0, expected) : result == expected;
+					failures += !ok;
+					printf("%s %10.2f %10.3f  %s\n", row,
+						2 * pixels * pixelTypeSize[type] * iterations / elapsed / 1e9,
+						cycles / (pixels * iterations),
+						ok ? "ok" : "MISMATCH");
+				}
+			}
+		}
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d kernel result(s) differ from get_sad_c\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,182 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Differential fuzzer for the SAD kernels.
+//
+// Generates plane pairs with random widths, heights, pitches, alignments, bit depths and
+// content, and checks that PlaneSAD under every CPU flag combination, and each kernel called
+// directly where its preconditions hold, returns exactly what get_sad_c returns (float within
+// rounding). Prints the first failing case and exits non-zero on a mismatch.
+//
+//   smoothskip_kernel_fuzz [--iterations 20000] [--seed N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "3rd-party/avs/cpuid.h"
+#include "PlaneDiff.h"
+#include "FrameDiffKernels.h"
+
+#define MAX_WIDTH 16384   // wider than any AviSynth frame the filter will see
+#define MAX_HEIGHT 64
+
+struct FuzzCase {
+	int bits, pixelsize;
+	int width, height, rowsize;
+	int pitch[2], skew[2];
+	const char* content;
+};
+
+static const int cpuFlagSets[] = {
+	0,
+	CPUF_MMX | CPUF_INTEGER_SSE,
+	CPUF_MMX | CPUF_INTEGER_SSE | CPUF_SSE | CPUF_SSE2,
+};
+
+template<typename pixel_t>
+static void fill(BYTE* a, BYTE* b, const FuzzCase& c, std::mt19937& rng) {
+	const double maxValue = c.bits == 32 ? 1.0 : double((1 << c.bits) - 1);
+	std::uniform_real_distribution<double> unit(0, 1);
+	std::uniform_int_distribution<int> mode(0, 2);
+
+	for (int y = 0; y < c.height; y++) {
+		pixel_t* ra = reinterpret_cast<pixel_t*>(a + size_t(y) * c.pitch[0]);
+		pixel_t* rb = reinterpret_cast<pixel_t*>(b + size_t(y) * c.pitch[1]);
+		for (int x = 0; x < c.width; x++) {
+			double va, vb;
+			if (!strcmp(c.content, "extreme")) {         // largest possible differences, for overflow
+				va = (x + y) & 1 ? maxValue : 0;
+				vb = maxValue - va;
+			} else if (!strcmp(c.content, "similar")) {  // consecutive-frame like
+				va = unit(rng) * maxValue;
+				vb = std::min(maxValue, std::max(0.0, va + (unit(rng) - 0.5) * maxValue / 16));
+			} else {
+				va = unit(rng) * maxValue;
+				vb = unit(rng) * maxValue;
+			}
+			ra[x] = c.bits == 32 ? pixel_t(va) : pixel_t(std::lround(va));
+			rb[x] = c.bits == 32 ? pixel_t(vb) : pixel_t(std::lround(vb));
+		}
+	}
+}
+
+static FuzzCase randomCase(std::mt19937& rng) {
+	static const int depths[] = { 8, 10, 12, 14, 16, 32 };
+	static const char* contents[] = { "random", "similar", "extreme" };
+	auto pick = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+	FuzzCase c;
+	c.bits = depths[pick(0, 5)];
+	c.pixelsize = c.bits == 8 ? 1 : c.bits == 32 ? 4 : 2;
+	c.width = pick(0, 9) == 0 ? pick(1, MAX_WIDTH) : pick(1, 300);
+	c.height = pick(1, c.width > 4096 ? 4 : MAX_HEIGHT);
+	c.rowsize = c.width * c.pixelsize;
+	for (int i = 0; i < 2; i++) {
+		switch (pick(0, 2)) {  // exact, padded to 16/64 like a real frame, or arbitrary
+		case 0:  c.pitch[i] = c.rowsize; break;
+		case 1:  c.pitch[i] = (c.rowsize + 63) / 64 * 64; break;
+		default: c.pitch[i] = c.rowsize + pick(0, 40) * c.pixelsize; break;
+		}
+		c.skew[i] = pick(0, 1) ? 0 : pick(1, 63 / c.pixelsize) * c.pixelsize;
+	}
+	c.content = contents[pick(0, 2)];
+	return c;
+}
+
+static void describe(const FuzzCase& c) {
+	fprintf(stderr, "  bits %d, %dx%d, pitches %d/%d, skews %d/%d, content %s\n",
+		c.bits, c.width, c.height, c.pitch[0], c.pitch[1], c.skew[0], c.skew[1], c.content);
+}
+
+int main(int argc, char** argv) {
+	long iterations = 20000;
+	unsigned seed = std::random_device()();
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "--iterations")) iterations = atol(argv[i + 1]);
+		else if (!strcmp(argv[i], "--seed")) seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+		else {
+			fprintf(stderr, "usage: smoothskip_kernel_fuzz [--iterations N] [--seed N]\n");
+			return 2;
+		}
+	}
+	printf("seed %u, %ld iterations\n", seed, iterations);
+
+	std::mt19937 rng(seed);
+	std::vector<BYTE> storage[2];
+	long checks = 0;
+
+	for (long it = 0; it < iterations; it++) {
+		FuzzCase c = randomCase(rng);
+		BYTE* plane[2];
+		for (int i = 0; i < 2; i++) {
+			storage[i].assign(size_t(c.pitch[i]) * c.height + 128, 0xCD);
+			plane[i] = storage[i].data() + (64 - (uintptr_t)storage[i].data() % 64) % 64 + c.skew[i];
+		}
+		switch (c.pixelsize) {
+		case 1: fill<uint8_t>(plane[0], plane[1], c, rng); break;
+		case 2: fill<uint16_t>(plane[0], plane[1], c, rng); break;
+		case 4: fill<float>(plane[0], plane[1], c, rng); break;
+		}
+
+		double expected;
+		switch (c.pixelsize) {
+		case 1:  expected = get_sad_c<uint8_t>(plane[0], plane[1], c.height, c.width, c.pitch[0], c.pitch[1]); break;
+		case 2:  expected = get_sad_c<uint16_t>(plane[0], plane[1], c.height, c.width, c.pitch[0], c.pitch[1]); break;
+		default: expected = get_sad_c<float>(plane[0], plane[1], c.height, c.width, c.pitch[0], c.pitch[1]); break;
+		}
+
+		struct Result { const char* kernel; int flags; double sad; };
+		std::vector<Result> results;
+		for (int flags : cpuFlagSets) {
+			results.push_back({ "PlaneSAD", flags, PlaneSAD(plane[0], plane[1], c.pitch[0], c.pitch[1], c.rowsize, c.height, c.pixelsize, c.bits, flags) });
+		}
+
+		bool sse2Layout = (uintptr_t)plane[0] % 16 == 0 && (uintptr_t)plane[1] % 16 == 0 &&
+		                  c.pitch[0] % 16 == 0 && c.pitch[1] % 16 == 0 && c.rowsize >= 16;
+		if (sse2Layout && c.pixelsize == 1)
+			results.push_back({ "sse2", 0, (double)calculate_sad_8_or_16_sse2<uint8_t, false>(plane[0], plane[1], c.pitch[0], c.pitch[1], c.rowsize, c.height) });
+		if (sse2Layout && c.pixelsize == 2)
+			results.push_back({ "sse2", 0, (double)calculate_sad_8_or_16_sse2<uint16_t, false>(plane[0], plane[1], c.pitch[0], c.pitch[1], c.rowsize, c.height) });
+		if (c.rowsize >= 16 && c.pixelsize == 1)
+			results.push_back({ "sse2 unaligned", 0, (double)calculate_sad_8_or_16_sse2<uint8_t, false, false>(plane[0], plane[1], c.pitch[0], c.pitch[1], c.rowsize, c.height) });
+		if (c.rowsize >= 16 && c.pixelsize == 2)
+			results.push_back({ "sse2 unaligned", 0, (double)calculate_sad_8_or_16_sse2<uint16_t, false, false>(plane[0], plane[1], c.pitch[0], c.pitch[1], c.rowsize, c.height) });
+#ifdef X86_32
+		if (c.pixelsize == 1 && (double)c.width * c.height * 255 <= 2147483647.0)
+			results.push_back({ "isse", 0, (double)get_sad_isse(plane[0], plane[1], c.height, c.width, c.pitch[0], c.pitch[1]) });
+#endif
+
+		for (const Result& r : results) {
+			bool ok = c.pixelsize == 4 ? std::fabs(r.sad - expected) <= 1e-9 * std::max(1.0, expected) : r.sad == expected;
+			checks++;
+			if (!ok) {
+				fprintf(stderr, "iteration %ld: %s (cpu flags 0x%x) returned %.17g, get_sad_c %.17g\n",
+					it, r.kernel, r.flags, r.sad, expected);
+				describe(c);
+				return 1;
+			}
+		}
+	}
+
+	printf("%ld checks passed\n", checks);
+	return 0;
+}
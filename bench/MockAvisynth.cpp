@@ -0,0 +1,424 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Definitions of the core side of avisynth.h for BUILDING_AVSCORE builds of the filter. Only what
+// the filter and the benchmark use is implemented: planar and YUY2 frames, clip and frame
+// reference counting and the AVSValue types that appear in filter arguments.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include "MockAvisynth.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+static long atomicAdd(volatile long* value, long delta) {
+#ifdef _MSC_VER
+	return _InterlockedExchangeAdd(value, delta) + delta;
+#else
+	return __sync_add_and_fetch(value, delta);
+#endif
+}
+
+static BYTE* alignedAlloc(size_t size, size_t align) {
+#ifdef _MSC_VER
+	return static_cast<BYTE*>(_aligned_malloc(size, align));
+#else
+	void* p = nullptr;
+	return posix_memalign(&p, align, size) == 0 ? static_cast<BYTE*>(p) : nullptr;
+#endif
+}
+
+static void alignedFree(BYTE* p) {
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+static int alignUp(int n, int align) {
+	return (n + align - 1) / align * align;
+}
+
+static bool isChroma(int plane) {
+	return (plane & (PLANAR_U | PLANAR_V)) != 0;
+}
+
+// ==========================================================================
+// VideoInfo
+// ==========================================================================
+
+bool VideoInfo::HasVideo() const { return width != 0; }
+bool VideoInfo::IsYUY2() const { return (pixel_type & CS_YUY2) == CS_YUY2; }
+bool VideoInfo::IsPlanar() const { return (pixel_type & CS_PLANAR) != 0; }
+bool VideoInfo::IsYUV() const { return (pixel_type & CS_YUV) != 0; }
+bool VideoInfo::IsY() const { return (pixel_type & CS_PLANAR_MASK) == (CS_GENERIC_Y & CS_PLANAR_FILTER); }
+bool VideoInfo::IsY8() const { return (pixel_type & CS_PLANAR_MASK) == (CS_Y8 & CS_PLANAR_FILTER); }
+bool VideoInfo::IsColorSpace(int c_space) const {
+	return IsPlanar() ? ((pixel_type & CS_PLANAR_MASK) == (c_space & CS_PLANAR_FILTER)) : ((pixel_type & c_space) == c_space);
+}
+bool VideoInfo::IsYV12() const { return IsColorSpace(CS_YV12) || IsColorSpace(CS_I420); }
+bool VideoInfo::Is420() const { return IsPlanar() && IsYUV() && !IsY() && GetPlaneHeightSubsampling(PLANAR_U) == 1; }
+
+int VideoInfo::GetPlaneWidthSubsampling(int plane) const {
+	if (!isChroma(plane) || IsY()) return 0;
+	return ((pixel_type >> CS_Shift_Sub_Width) + 1) & 3;
+}
+
+int VideoInfo::GetPlaneHeightSubsampling(int plane) const {
+	if (!isChroma(plane) || IsY()) return 0;
+	return ((pixel_type >> CS_Shift_Sub_Height) + 1) & 3;
+}
+
+int VideoInfo::ComponentSize() const {
+	if (!IsPlanar()) return 1;
+	const int componentSizes[8] = { 1, 2, 4, 0, 0, 2, 2, 2 };
+	return componentSizes[(pixel_type >> CS_Shift_Sample_Bits) & 7];
+}
+
+int VideoInfo::BitsPerComponent() const {
+	if (!IsPlanar()) return 8;
+	const int componentBits[8] = { 8, 16, 32, 0, 0, 10, 12, 14 };
+	return componentBits[(pixel_type >> CS_Shift_Sample_Bits) & 7];
+}
+
+void VideoInfo::SetFPS(unsigned numerator, unsigned denominator) {
+	unsigned a = numerator, b = denominator;
+	while (b) { unsigned t = a % b; a = b; b = t; }
+	fps_numerator = numerator / a;
+	fps_denominator = denominator / a;
+}
+
+void VideoInfo::MulDivFPS(unsigned multiplier, unsigned divisor) {
+	uint64_t numerator = (uint64_t)fps_numerator * multiplier;
+	uint64_t denominator = (uint64_t)fps_denominator * divisor;
+	uint64_t a = numerator, b = denominator;
+	while (b) { uint64_t t = a % b; a = b; b = t; }
+	numerator /= a;
+	denominator /= a;
+	while (numerator > 0xFFFFFFFFull || denominator > 0xFFFFFFFFull) {
+		numerator >>= 1;
+		denominator >>= 1;
+	}
+	fps_numerator = (unsigned)numerator;
+	fps_denominator = (unsigned)denominator;
+}
+
+// ==========================================================================
+// VideoFrameBuffer / VideoFrame
+// ==========================================================================
+
+VideoFrameBuffer::VideoFrameBuffer(int size) :
+data(alignedAlloc(size, FRAME_ALIGN)), data_size(size), sequence_number(0), refcount(0) {}
+
+VideoFrameBuffer::VideoFrameBuffer() : data(nullptr), data_size(0), sequence_number(0), refcount(0) {}
+
+VideoFrameBuffer::~VideoFrameBuffer() {
+	alignedFree(data);
+}
+
+const BYTE* VideoFrameBuffer::GetReadPtr() const { return data; }
+BYTE* VideoFrameBuffer::GetWritePtr() { atomicAdd(&sequence_number, 1); return data; }
+int VideoFrameBuffer::GetDataSize() const { return data_size; }
+int VideoFrameBuffer::GetSequenceNumber() const { return sequence_number; }
+int VideoFrameBuffer::GetRefcount() const { return refcount; }
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, int _offset, int _pitch, int _row_size, int _height) :
+refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+offsetU(_offset), offsetV(_offset), pitchUV(0), row_sizeUV(0), heightUV(0), offsetA(0), pitchA(0), row_sizeA(0) {
+	atomicAdd(&vfb->refcount, 1);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, int _offset, int _pitch, int _row_size, int _height,
+                       int _offsetU, int _offsetV, int _pitchUV, int _row_sizeUV, int _heightUV) :
+refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+offsetU(_offsetU), offsetV(_offsetV), pitchUV(_pitchUV), row_sizeUV(_row_sizeUV), heightUV(_heightUV),
+offsetA(0), pitchA(0), row_sizeA(0) {
+	atomicAdd(&vfb->refcount, 1);
+}
+
+void* VideoFrame::operator new(size_t size) {
+	return ::operator new(size);
+}
+
+VideoFrame::~VideoFrame() {
+	DESTRUCTOR();
+}
+
+void VideoFrame::DESTRUCTOR() {
+	if (vfb && atomicAdd(&vfb->refcount, -1) == 0) {
+		delete vfb;
+	}
+	vfb = nullptr;
+}
+
+void VideoFrame::AddRef() {
+	atomicAdd(&refcount, 1);
+}
+
+void VideoFrame::Release() {
+	if (atomicAdd(&refcount, -1) == 0) {
+		delete this;
+	}
+}
+
+int VideoFrame::GetPitch(int plane) const { return isChroma(plane) ? pitchUV : pitch; }
+int VideoFrame::GetRowSize(int plane) const { return isChroma(plane) ? row_sizeUV : row_size; }
+int VideoFrame::GetHeight(int plane) const { return isChroma(plane) ? heightUV : height; }
+VideoFrameBuffer* VideoFrame::GetFrameBuffer() const { return vfb; }
+
+int VideoFrame::GetOffset(int plane) const {
+	if (plane & PLANAR_U) return offsetU;
+	if (plane & PLANAR_V) return offsetV;
+	return offset;
+}
+
+const BYTE* VideoFrame::GetReadPtr(int plane) const {
+	return vfb->GetReadPtr() + GetOffset(plane);
+}
+
+bool VideoFrame::IsWritable() const {
+	return refcount == 1 && vfb->refcount == 1;
+}
+
+// Like the real core, only a frame nobody else references may be written to.
+BYTE* VideoFrame::GetWritePtr(int plane) const {
+	return IsWritable() ? vfb->GetWritePtr() + GetOffset(plane) : nullptr;
+}
+
+// ==========================================================================
+// IClip / PClip / PVideoFrame
+// ==========================================================================
+
+void IClip::AddRef() {
+	atomicAdd(&refcnt, 1);
+}
+
+void IClip::Release() {
+	if (atomicAdd(&refcnt, -1) == 0) {
+		delete this;
+	}
+}
+
+IClip* PClip::GetPointerWithAddRef() const {
+	if (p) p->AddRef();
+	return p;
+}
+
+void PClip::Init(IClip* x) {
+	if (x) x->AddRef();
+	p = x;
+}
+
+void PClip::Set(IClip* x) {
+	if (x) x->AddRef();
+	if (p) p->Release();
+	p = x;
+}
+
+PClip::PClip() : p(nullptr) {}
+PClip::PClip(const PClip& x) { Init(x.p); }
+PClip::PClip(IClip* x) { Init(x); }
+void PClip::operator=(IClip* x) { Set(x); }
+void PClip::operator=(const PClip& x) { Set(x.p); }
+PClip::~PClip() { if (p) p->Release(); }
+
+void PVideoFrame::Init(VideoFrame* x) {
+	if (x) x->AddRef();
+	p = x;
+}
+
+void PVideoFrame::Set(VideoFrame* x) {
+	if (x) x->AddRef();
+	if (p) p->Release();
+	p = x;
+}
+
+PVideoFrame::PVideoFrame() : p(nullptr) {}
+PVideoFrame::PVideoFrame(const PVideoFrame& x) { Init(x.p); }
+PVideoFrame::PVideoFrame(VideoFrame* x) { Init(x); }
+void PVideoFrame::operator=(VideoFrame* x) { Set(x); }
+void PVideoFrame::operator=(const PVideoFrame& x) { Set(x.p); }
+PVideoFrame::~PVideoFrame() { if (p) p->Release(); }
+
+// ==========================================================================
+// AVSValue
+// ==========================================================================
+
+AVSValue::AVSValue() : type('v'), array_size(0), clip(nullptr) {}
+AVSValue::AVSValue(IClip* c) : type('c'), array_size(0), clip(c) { if (c) c->AddRef(); }
+AVSValue::AVSValue(const PClip& c) : type('c'), array_size(0), clip(c.GetPointerWithAddRef()) {}
+AVSValue::AVSValue(bool b) : type('b'), array_size(0), clip(nullptr) { boolean = b; }
+AVSValue::AVSValue(int i) : type('i'), array_size(0), clip(nullptr) { integer = i; }
+AVSValue::AVSValue(float f) : type('f'), array_size(0), clip(nullptr) { floating_pt = f; }
+AVSValue::AVSValue(double f) : type('f'), array_size(0), clip(nullptr) { floating_pt = float(f); }
+AVSValue::AVSValue(const char* s) : type('s'), array_size(0), clip(nullptr) { string = s; }
+AVSValue::AVSValue(const AVSValue* a, int size) : type('a'), array_size(short(size)), clip(nullptr) { array = a; }
+AVSValue::AVSValue(const AVSValue& a, int size) : type('a'), array_size(short(size)), clip(nullptr) { array = &a; }
+AVSValue::AVSValue(const AVSValue& v) { Assign(&v, true); }
+
+AVSValue::~AVSValue() {
+	if (IsClip() && clip) clip->Release();
+}
+
+AVSValue& AVSValue::operator=(const AVSValue& v) {
+	Assign(&v, false);
+	return *this;
+}
+
+// Arrays don't own their elements, as in classic AviSynth.
+void AVSValue::Assign(const AVSValue* src, bool init) {
+	if (src->IsClip() && src->clip) src->clip->AddRef();
+	if (!init && IsClip() && clip) clip->Release();
+
+	type = src->type;
+	array_size = src->array_size;
+	switch (type) {
+	case 'c': clip = src->clip; break;
+	case 'b': boolean = src->boolean; break;
+	case 'i': integer = src->integer; break;
+	case 'f': floating_pt = src->floating_pt; break;
+	case 's': string = src->string; break;
+	case 'a': array = src->array; break;
+	default:  clip = nullptr; break;
+	}
+}
+
+bool AVSValue::Defined() const { return type != 'v'; }
+bool AVSValue::IsClip() const { return type == 'c'; }
+bool AVSValue::IsBool() const { return type == 'b'; }
+bool AVSValue::IsInt() const { return type == 'i'; }
+bool AVSValue::IsFloat() const { return type == 'f' || type == 'i'; }
+bool AVSValue::IsString() const { return type == 's'; }
+bool AVSValue::IsArray() const { return type == 'a'; }
+
+PClip AVSValue::AsClip() const { return IsClip() ? clip : nullptr; }
+bool AVSValue::AsBool(bool def) const { return IsBool() ? boolean : def; }
+int AVSValue::AsInt(int def) const { return IsInt() ? integer : def; }
+int AVSValue::AsInt() const { return IsInt() ? integer : 0; }
+double AVSValue::AsFloat(float def) const { return IsInt() ? integer : type == 'f' ? floating_pt : def; }
+const char* AVSValue::AsString(const char* def) const { return IsString() ? string : def; }
+int AVSValue::ArraySize() const { return IsArray() ? array_size : 1; }
+
+const AVSValue& AVSValue::operator[](int index) const {
+	return (IsArray() && index >= 0 && index < array_size) ? array[index] : *this;
+}
+
+// ==========================================================================
+// ScriptEnvironment
+// ==========================================================================
+
+ScriptEnvironment::ScriptEnvironment(int _cpuFlags) : cpuFlags(_cpuFlags) {}
+
+PVideoFrame __stdcall ScriptEnvironment::NewVideoFrame(const VideoInfo& vi, int align) {
+	align = std::max(align, FRAME_ALIGN);
+	int rowSize = vi.width * (vi.IsYUY2() ? 2 : vi.ComponentSize());
+	int pitch = alignUp(rowSize, align);
+
+	if (!vi.IsPlanar() || vi.IsY()) {
+		VideoFrameBuffer* vfb = new VideoFrameBuffer(pitch * vi.height);
+		return new VideoFrame(vfb, 0, pitch, rowSize, vi.height);
+	}
+
+	int rowSizeUV = rowSize >> vi.GetPlaneWidthSubsampling(PLANAR_U);
+	int heightUV = vi.height >> vi.GetPlaneHeightSubsampling(PLANAR_U);
+	int pitchUV = alignUp(rowSizeUV, align);
+	int offsetU = pitch * vi.height;
+	int offsetV = offsetU + pitchUV * heightUV;
+	if (vi.IsYV12() && !vi.IsColorSpace(VideoInfo::CS_I420)) std::swap(offsetU, offsetV);  // YV12 stores V first
+
+	VideoFrameBuffer* vfb = new VideoFrameBuffer(pitch * vi.height + 2 * pitchUV * heightUV);
+	return new VideoFrame(vfb, 0, pitch, rowSize, vi.height, offsetU, offsetV, pitchUV, rowSizeUV, heightUV);
+}
+
+bool __stdcall ScriptEnvironment::MakeWritable(PVideoFrame* pvf) {
+	const VideoFrame* src = pvf->operator->();
+	if (src->IsWritable()) return false;
+
+	VideoFrameBuffer* vfb = new VideoFrameBuffer(src->vfb->GetDataSize());
+	memcpy(vfb->data, src->vfb->GetReadPtr(), src->vfb->GetDataSize());
+	*pvf = new VideoFrame(vfb, src->offset, src->pitch, src->row_size, src->height,
+	                      src->offsetU, src->offsetV, src->pitchUV, src->row_sizeUV, src->heightUV);
+	return true;
+}
+
+void __stdcall ScriptEnvironment::BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height) {
+	for (int y = 0; y < height; y++, dstp += dst_pitch, srcp += src_pitch) {
+		memcpy(dstp, srcp, row_size);
+	}
+}
+
+int __stdcall ScriptEnvironment::GetCPUFlags() {
+	return cpuFlags;
+}
+
+char* __stdcall ScriptEnvironment::SaveString(const char* s, int length) {
+	std::lock_guard<std::mutex> lockGuard(mutex);
+	strings.push_back(length < 0 ? std::string(s) : std::string(s, length));
+	return &strings.back()[0];
+}
+
+char* __stdcall ScriptEnvironment::Sprintf(const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	char* s = VSprintf(fmt, &args);
+	va_end(args);
+	return s;
+}
+
+char* __stdcall ScriptEnvironment::VSprintf(const char* fmt, void* val) {
+	char buff[4096];
+	vsnprintf(buff, sizeof(buff), fmt, *static_cast<va_list*>(val));
+	return SaveString(buff);
+}
+
+void __stdcall ScriptEnvironment::ThrowError(const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	char* msg = VSprintf(fmt, &args);
+	va_end(args);
+	throw AvisynthError(msg);
+}
+
+void __stdcall ScriptEnvironment::AddFunction(const char*, const char*, ApplyFunc, void*) { ThrowError("AddFunction is not supported"); }
+bool __stdcall ScriptEnvironment::FunctionExists(const char*) { return false; }
+AVSValue __stdcall ScriptEnvironment::Invoke(const char* name, const AVSValue, const char* const*) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::GetVar(const char*) { throw NotFound(); }
+bool __stdcall ScriptEnvironment::SetVar(const char*, const AVSValue&) { return false; }
+bool __stdcall ScriptEnvironment::SetGlobalVar(const char*, const AVSValue&) { return false; }
+void __stdcall ScriptEnvironment::PushContext(int) {}
+void __stdcall ScriptEnvironment::PopContext() {}
+void __stdcall ScriptEnvironment::AtExit(ShutdownFunc, void*) {}
+void __stdcall ScriptEnvironment::CheckVersion(int) {}
+PVideoFrame __stdcall ScriptEnvironment::Subframe(PVideoFrame src, int, int, int, int) { ThrowError("Subframe is not supported"); return src; }
+int __stdcall ScriptEnvironment::SetMemoryMax(int) { return 0; }
+int __stdcall ScriptEnvironment::SetWorkingDir(const char*) { return -1; }
+void* __stdcall ScriptEnvironment::ManageCache(int, void*) { return nullptr; }
+bool __stdcall ScriptEnvironment::PlanarChromaAlignment(PlanarChromaAlignmentMode) { return false; }
+PVideoFrame __stdcall ScriptEnvironment::SubframePlanar(PVideoFrame src, int, int, int, int, int, int, int) { ThrowError("SubframePlanar is not supported"); return src; }
+void __stdcall ScriptEnvironment::DeleteScriptEnvironment() {}
+void __stdcall ScriptEnvironment::ApplyMessage(PVideoFrame*, const VideoInfo&, const char*, int, int, int, int) {}
+const AVS_Linkage* const __stdcall ScriptEnvironment::GetAVSLinkage() { return nullptr; }
+AVSValue __stdcall ScriptEnvironment::GetVarDef(const char*, const AVSValue& def) { return def; }
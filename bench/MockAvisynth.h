@@ -0,0 +1,74 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <mutex>
+#include <list>
+#include <string>
+#include "3rd-party/avisynth.h"
+
+/**
+ * Stand-in for the AviSynth core, so that the filter can be driven without a host.
+ * The filter sources are compiled with BUILDING_AVSCORE, which makes the VideoFrame,
+ * PClip and AVSValue methods link against MockAvisynth.cpp instead of going through
+ * AVS_linkage. Frames are plain heap allocations, there is no frame cache.
+ */
+class ScriptEnvironment : public IScriptEnvironment {
+	std::mutex mutex;
+	std::list<std::string> strings;   // storage behind SaveString and error messages
+	int cpuFlags;
+
+public:
+	explicit ScriptEnvironment(int cpuFlags);
+
+	// Planar frame of the given format, every plane FRAME_ALIGN aligned.
+	PVideoFrame __stdcall NewVideoFrame(const VideoInfo& vi, int align = FRAME_ALIGN) override;
+	bool __stdcall MakeWritable(PVideoFrame* pvf) override;
+	void __stdcall BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height) override;
+
+	int __stdcall GetCPUFlags() override;
+	char* __stdcall SaveString(const char* s, int length = -1) override;
+	char* __stdcall Sprintf(const char* fmt, ...) override;
+	char* __stdcall VSprintf(const char* fmt, void* val) override;
+	__declspec(noreturn) void __stdcall ThrowError(const char* fmt, ...) override;
+
+	// Script related functionality the filter doesn't use. These throw.
+	void __stdcall AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data) override;
+	bool __stdcall FunctionExists(const char* name) override;
+	AVSValue __stdcall Invoke(const char* name, const AVSValue args, const char* const* arg_names = 0) override;
+	AVSValue __stdcall GetVar(const char* name) override;
+	bool __stdcall SetVar(const char* name, const AVSValue& val) override;
+	bool __stdcall SetGlobalVar(const char* name, const AVSValue& val) override;
+	void __stdcall PushContext(int level = 0) override;
+	void __stdcall PopContext() override;
+	void __stdcall AtExit(ShutdownFunc function, void* user_data) override;
+	void __stdcall CheckVersion(int version = AVISYNTH_INTERFACE_VERSION) override;
+	PVideoFrame __stdcall Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height) override;
+	int __stdcall SetMemoryMax(int mem) override;
+	int __stdcall SetWorkingDir(const char* newdir) override;
+	void* __stdcall ManageCache(int key, void* data) override;
+	bool __stdcall PlanarChromaAlignment(PlanarChromaAlignmentMode key) override;
+	PVideoFrame __stdcall SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+	                                     int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV) override;
+	void __stdcall DeleteScriptEnvironment() override;
+	void __stdcall ApplyMessage(PVideoFrame* frame, const VideoInfo& vi, const char* message, int size,
+	                            int textcolor, int halocolor, int bgcolor) override;
+	const AVS_Linkage* const __stdcall GetAVSLinkage() override;
+	AVSValue __stdcall GetVarDef(const char* name, const AVSValue& def = AVSValue()) override;
+};
@@ -0,0 +1,379 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Throughput benchmark of SmoothSkip::GetFrame outside of an AviSynth host.
+//
+// The filter is fed a synthetic clip whose content pans at constant speed, except that every
+// --stutter'th frame the pan skips ahead a step, which is what SmoothSkip is there to detect.
+// Output frames are requested by --threads threads in roughly ascending order, as AviSynth+
+// MT does. Reports output frames/s, the latency of each cycle analysis and the time threads
+// spend waiting for the getFrameMapping lock. --stats adds the filter's counters, as written by its stats option.
+// --trace writes the filter's Chrome trace of the run to a file. --synth blend or motion makes the inserted
+// frames in the filter instead of fetching them from the alt clip. --confidence sets the filter's confidence
+// threshold; with --stutter 0 the clip has no skips, so every inserted frame is of a low confidence cycle.
+// --static sets the filter's static noise floor; --pan 0 makes the clip a still image, all cycles static.
+// --qpfile and --zones write the filter's encoder hint files. --timecodes runs the filter with mode="timecodes",
+// writing the timecodes file instead of inserting frames. --dupes makes the filter drop that many frames of each cycle.
+// --debuglog writes the filter's debug log.
+//
+// After the run the bench checks that the output has the frame count the cycle settings give and, with
+// --timecodes, a timecode per frame. --verify also renders the clip in VERIFY_SEGMENTS segments with
+// segment_start/segment_end and checks that they stitch to the unsegmented output, frame for frame.
+//
+//   smoothskip_bench [--width 1920] [--height 1080] [--frames 3000] [--threads N]
+//                    [--cycle 4] [--create 1] [--dupes 0] [--stutter 4] [--cache 0] [--debug] [--stats] [--trace file]
+//                    [--synth altclip|blend|motion] [--confidence 0] [--static 0] [--pan 4]
+//                    [--qpfile file] [--zones file] [--timecodes file] [--debuglog file]
+//                    [--cpu auto|c] [--verify]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MockAvisynth.h"
+#include "SmoothSkip.h"
+
+#define PAN_POSITIONS 16  // distinct frames of the synthetic clip; the pan repeats after this many steps
+#define VERIFY_SEGMENTS 3 // segments rendered by --verify
+#define PAN_SPEED 4       // default pixels per step
+#define PAN_SLOPE 4       // luma steps per pixel of the triangle wave, which keeps the diff of a default skip
+                          // (28, to 15 for a plain step) below the default scene threshold of 32
+
+struct BenchOptions {
+	int width = 1920;
+	int height = 1080;
+	int frames = 3000;
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	int cycle = 4;
+	int create = 1;
+	int dupes = 0;
+	int stutter = 4;
+	int cache = 0;
+	bool debug = false;
+	bool stats = false;
+	std::string trace;
+	std::string synth = "altclip";
+	double confidence = 0;
+	double staticFloor = 0;
+	int pan = PAN_SPEED;
+	std::string qpfile;
+	std::string zones;
+	std::string timecodes;
+	std::string debugLog;
+	bool c = false;
+	bool verify = false;
+};
+
+// Horizontally panning triangle wave over a fixed set of pre-rendered frames.
+class SyntheticClip : public IClip {
+	VideoInfo vi;
+	int stutter;
+	int pan;
+	std::vector<PVideoFrame> positions;
+
+	void render(PVideoFrame& frame, int position) {
+		for (int plane : { PLANAR_Y, PLANAR_U, PLANAR_V }) {
+			BYTE* row = frame->GetWritePtr(plane);
+			int pitch = frame->GetPitch(plane);
+			int width = frame->GetRowSize(plane);
+			int height = frame->GetHeight(plane);
+			for (int y = 0; y < height; y++, row += pitch) {
+				for (int x = 0; x < width; x++) {
+					int v = 128;
+					if (plane == PLANAR_Y) {
+						int t = (x + position * pan) % (PAN_POSITIONS * PAN_SPEED);
+						v = (t < PAN_POSITIONS * PAN_SPEED / 2 ? t : PAN_POSITIONS * PAN_SPEED - 1 - t) * PAN_SLOPE;
+					}
+					row[x] = BYTE(v);
+				}
+			}
+		}
+	}
+
+public:
+	SyntheticClip(const BenchOptions& opt, IScriptEnvironment* env) : stutter(opt.stutter), pan(opt.pan) {
+		memset(&vi, 0, sizeof(vi));
+		vi.width = opt.width;
+		vi.height = opt.height;
+		vi.fps_numerator = 24000;
+		vi.fps_denominator = 1001;
+		vi.num_frames = opt.frames;
+		vi.pixel_type = VideoInfo::CS_YV12;   // the filter takes YV12 or YUY2 only
+
+		for (int i = 0; i < PAN_POSITIONS; i++) {
+			PVideoFrame frame = env->NewVideoFrame(vi);
+			render(frame, i);
+			positions.push_back(frame);
+		}
+	}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment*) override {
+		int position = stutter > 0 ? n + n / stutter : n;  // skips a step every stutter frames
+		return positions[position % PAN_POSITIONS];
+	}
+
+	bool __stdcall GetParity(int) override { return false; }
+	void __stdcall GetAudio(void*, __int64, __int64, IScriptEnvironment*) override {}
+	int __stdcall SetCacheHints(int, int) override { return 0; }
+	const VideoInfo& __stdcall GetVideoInfo() override { return vi; }
+};
+
+static void usage() {
+	fprintf(stderr,
+		"usage: smoothskip_bench [--width N] [--height N] [--frames N] [--threads N]\n"
+		"                        [--cycle N] [--create N] [--dupes N] [--stutter N] [--cache N] [--debug] [--stats] [--trace file]\n"
+		"                        [--synth altclip|blend|motion] [--confidence R] [--static F] [--pan N]\n"
+		"                        [--qpfile file] [--zones file] [--timecodes file] [--debuglog file]\n"
+		"                        [--cpu auto|c] [--verify]\n");
+	exit(2);
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+	BenchOptions opt;
+	for (int i = 1; i < argc; i++) {
+		std::string name = argv[i];
+		if (name == "--debug") { opt.debug = true; continue; }
+		if (name == "--stats") { opt.stats = true; continue; }
+		if (name == "--verify") { opt.verify = true; continue; }
+		if (i + 1 >= argc) usage();
+		const char* value = argv[++i];
+		if (name == "--width") opt.width = atoi(value);
+		else if (name == "--height") opt.height = atoi(value);
+		else if (name == "--frames") opt.frames = atoi(value);
+		else if (name == "--threads") opt.threads = std::max(1, atoi(value));
+		else if (name == "--cycle") opt.cycle = atoi(value);
+		else if (name == "--create") opt.create = atoi(value);
+		else if (name == "--dupes") opt.dupes = atoi(value);
+		else if (name == "--stutter") opt.stutter = atoi(value);
+		else if (name == "--cache") opt.cache = atoi(value);
+		else if (name == "--trace") opt.trace = value;
+		else if (name == "--synth") opt.synth = value;
+		else if (name == "--confidence") opt.confidence = atof(value);
+		else if (name == "--static") opt.staticFloor = atof(value);
+		else if (name == "--pan") opt.pan = std::max(0, atoi(value));
+		else if (name == "--qpfile") opt.qpfile = value;
+		else if (name == "--zones") opt.zones = value;
+		else if (name == "--timecodes") opt.timecodes = value;
+		else if (name == "--debuglog") opt.debugLog = value;
+		else if (name == "--cpu" && !strcmp(value, "c")) opt.c = true;
+		else if (name == "--cpu" && !strcmp(value, "auto")) opt.c = false;
+		else usage();
+	}
+	return opt;
+}
+
+static double ms(long long ns) {
+	return ns / 1e6;
+}
+
+// The filter of the options over the source frames first to last, -1 for the last frame of the clip.
+// Only the measured run writes the files of the options. The others write none but the timecodes file
+// mode="timecodes" requires, to scratchTimecodes.
+static PClip createFilter(const BenchOptions& opt, PClip child, PClip alt, IScriptEnvironment* env, bool measured,
+                          int first = 0, int last = -1, const std::string& scratchTimecodes = "") {
+	AVSValue args[24];
+	args[0] = child;
+	args[1] = alt;
+	args[2] = opt.cycle;
+	args[3] = opt.create;
+	args[6] = opt.debug && measured;
+	args[7] = opt.cache;
+	args[9] = first;
+	args[10] = last;
+	args[13] = measured ? opt.trace.c_str() : "";
+	args[14] = opt.synth.c_str();
+	args[15] = opt.confidence;
+	args[16] = opt.staticFloor;
+	args[17] = measured ? opt.qpfile.c_str() : "";
+	args[18] = measured ? opt.zones.c_str() : "";
+	args[20] = opt.timecodes.empty() ? "insert" : "timecodes";
+	args[21] = measured ? opt.timecodes.c_str() : scratchTimecodes.c_str();
+	args[22] = opt.dupes;
+	args[23] = measured ? opt.debugLog.c_str() : "";
+	return Create_SmoothSkip(AVSValue(args, 24), nullptr, env).AsClip();
+}
+
+// Output frames the cycle settings give, counted cycle by cycle: each gets create frames, as many as it has
+// frames in a partial last cycle, and loses dupes, of which the frames missing from a partial cycle are the first.
+static int expectedOutputFrames(const BenchOptions& opt) {
+	if (!opt.timecodes.empty()) return opt.frames;   // retimed, nothing inserted
+	int frames = 0;
+	for (int start = 0; start < opt.frames; start += opt.cycle) {
+		int count = std::min(opt.cycle, opt.frames - start);
+		frames += count + std::min(count, opt.create) - std::max(opt.dupes - (opt.cycle - count), 0);
+	}
+	return frames;
+}
+
+static int countLines(const char* path) {
+	FILE* f = fopen(path, "r");
+	if (!f) return -1;
+	int lines = 0;
+	for (int c = fgetc(f); c != EOF; c = fgetc(f)) {
+		if (c == '\n') lines++;
+	}
+	fclose(f);
+	return lines;
+}
+
+// FNV-1a of the visible bytes of every plane of each output frame, served in order.
+static std::vector<uint64_t> outputHashes(PClip clip, IScriptEnvironment* env) {
+	std::vector<uint64_t> hashes;
+	for (int n = 0; n < clip->GetVideoInfo().num_frames; n++) {
+		PVideoFrame frame = clip->GetFrame(n, env);
+		uint64_t hash = 14695981039346656037ull;
+		for (int plane : { PLANAR_Y, PLANAR_U, PLANAR_V }) {
+			const BYTE* row = frame->GetReadPtr(plane);
+			for (int y = 0; y < frame->GetHeight(plane); y++, row += frame->GetPitch(plane)) {
+				for (int x = 0; x < frame->GetRowSize(plane); x++) {
+					hash = (hash ^ row[x]) * 1099511628211ull;
+				}
+			}
+		}
+		hashes.push_back(hash);
+	}
+	return hashes;
+}
+
+// Renders the clip unsegmented and in VERIFY_SEGMENTS segments, and compares the stitched segments to it.
+static bool verifySegments(const BenchOptions& opt, PClip child, PClip alt, IScriptEnvironment* env) {
+	if (opt.frames / VERIFY_SEGMENTS < opt.cycle) {
+		fprintf(stderr, "Too few frames for %d segments of at least a cycle\n", VERIFY_SEGMENTS);
+		return false;
+	}
+	std::string scratch = opt.timecodes.empty() ? "" : opt.timecodes + ".verify";
+	std::vector<uint64_t> whole = outputHashes(createFilter(opt, child, alt, env, false, 0, -1, scratch), env);
+	std::vector<uint64_t> stitched;
+	for (int i = 0; i < VERIFY_SEGMENTS; i++) {
+		int first = opt.frames * i / VERIFY_SEGMENTS, last = opt.frames * (i + 1) / VERIFY_SEGMENTS - 1;
+		std::vector<uint64_t> segment = outputHashes(createFilter(opt, child, alt, env, false, first, last, scratch), env);
+		stitched.insert(stitched.end(), segment.begin(), segment.end());
+	}
+	if (!scratch.empty()) remove(scratch.c_str());
+
+	if (stitched.size() != whole.size()) {
+		fprintf(stderr, "Stitched segments have %d frames, the unsegmented output %d\n", int(stitched.size()), int(whole.size()));
+		return false;
+	}
+	auto mismatch = std::mismatch(whole.begin(), whole.end(), stitched.begin());
+	if (mismatch.first != whole.end()) {
+		fprintf(stderr, "Stitched segments differ from the unsegmented output at frame %d\n", int(mismatch.first - whole.begin()));
+		return false;
+	}
+	printf("verified:    %d segments stitch to the unsegmented output\n", VERIFY_SEGMENTS);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions opt = parseOptions(argc, argv);
+	ScriptEnvironment env(opt.c ? 0 : CPUF_MMX | CPUF_INTEGER_SSE | CPUF_SSE | CPUF_SSE2);
+
+	try {
+		PClip child = new SyntheticClip(opt, &env);
+		PClip alt = new SyntheticClip(opt, &env);
+
+		PClip clip = createFilter(opt, child, alt, &env, true);
+		SmoothSkip* filter = dynamic_cast<SmoothSkip*>(clip.operator->());
+		int frames = clip->GetVideoInfo().num_frames;
+
+		printf("%dx%d YV12, %d source frames, cycle %d, create %d, stutter every %d, %d thread(s), %s kernels%s\n",
+			opt.width, opt.height, opt.frames, opt.cycle, opt.create, opt.stutter, opt.threads,
+			opt.c ? "C" : "SIMD", opt.debug ? ", debug overlay" : "");
+
+		std::atomic<int> next(0);
+		std::atomic<bool> failed(false);
+		std::string error;
+		std::vector<std::thread> workers;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int t = 0; t < opt.threads; t++) {
+			workers.emplace_back([&]() {
+				try {
+					for (int n = next++; n < frames && !failed; n = next++) {
+						clip->GetFrame(n, &env);
+					}
+				}
+				catch (AvisynthError& e) {
+					if (!failed.exchange(true)) error = e.msg;
+				}
+			});
+		}
+		for (auto& w : workers) w.join();
+		long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		if (failed) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+
+		std::vector<long long> analysis = filter->timings.analysisNs;
+		std::sort(analysis.begin(), analysis.end());
+		long long analysisTotal = 0;
+		for (long long ns : analysis) analysisTotal += ns;
+		long long lockWait = filter->counters.total(PERF_LOCK_WAIT_NS);
+		uint64_t inserted = filter->counters.total(PERF_ALT_FRAMES);
+
+		// Skips taken for scene changes insert no frames, so a clip whose skips all read as scene changes
+		// would measure the copying of source frames only.
+		if (inserted == 0 && opt.timecodes.empty()) {
+			fprintf(stderr, "No frames were inserted, the skips of the clip are above the scene threshold\n");
+			return 1;
+		}
+
+		printf("throughput:  %d frames in %.3f s, %.1f frames/s\n", frames, elapsed / 1e9, frames / (elapsed / 1e9));
+		if (!analysis.empty()) {
+			printf("analysis:    %d cycles, mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+				int(analysis.size()), ms(analysisTotal) / analysis.size(), ms(analysis[analysis.size() / 2]),
+				ms(analysis[analysis.size() * 99 / 100]), ms(analysis.back()));
+		}
+		printf("inserted:    %llu frames\n", (unsigned long long)inserted);
+		printf("lock wait:   %.3f s total, %.3f ms per frame, %.1f%% of thread time\n",
+			lockWait / 1e9, ms(lockWait) / frames, 100.0 * lockWait / (double(elapsed) * opt.threads));
+		if (opt.stats) {
+			fflush(stdout);
+			filter->writeStats("-");
+		}
+
+		// The files of the options are written as the filter is freed.
+		filter = nullptr;
+		clip = nullptr;
+
+		bool ok = true;
+		if (frames != expectedOutputFrames(opt)) {
+			fprintf(stderr, "Output has %d frames, the cycle settings give %d\n", frames, expectedOutputFrames(opt));
+			ok = false;
+		}
+		// The timecodes file has a format line, then a line per frame.
+		if (!opt.timecodes.empty() && countLines(opt.timecodes.c_str()) - 1 != frames) {
+			fprintf(stderr, "Timecodes file has %d timecodes for %d frames\n", countLines(opt.timecodes.c_str()) - 1, frames);
+			ok = false;
+		}
+		if (opt.verify && !verifySegments(opt, child, alt, &env)) ok = false;
+		if (!ok) return 1;
+	}
+	catch (AvisynthError& e) {
+		fprintf(stderr, "%s\n", e.msg);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// Stutter analysis of a Y4M file without AviSynth.
+//
+// Memory-maps the file, computes the luma diff of every frame to its predecessor in parallel,
+// straight from the mapped planes, classifies the cycles as SmoothSkip would, and writes the
+// result as an analysis file (AnalysisFile.h). SmoothSkip(..., input="file") then uses the
+// diffs instead of computing them.
+//
+//   smoothskip_analyze [--cycle 4] [--create 1] [--scene 32] [--threads N] input.y4m output.ssa
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Y4MFile.h"
+#include "AnalysisFile.h"
+#include "FixedCycle.h"
+#include "PlaneDiff.h"
+
+#define FRAMES_PER_TASK 16   // frames a thread claims at a time
+
+static void usage() {
+	fprintf(stderr, "usage: smoothskip_analyze [--cycle N] [--create N] [--scene F] [--threads N] input.y4m output.ssa\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	int cycle = 4, create = 1;
+	float scene = 32;
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	const char* paths[2] = { nullptr, nullptr };
+	int npaths = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-' && argv[i][1] == '-') {
+			if (i + 1 >= argc) usage();
+			const char* value = argv[++i];
+			if (!strcmp(argv[i - 1], "--cycle")) cycle = atoi(value);
+			else if (!strcmp(argv[i - 1], "--create")) create = atoi(value);
+			else if (!strcmp(argv[i - 1], "--scene")) scene = static_cast<float>(atof(value));
+			else if (!strcmp(argv[i - 1], "--threads")) threads = std::max(1, atoi(value));
+			else usage();
+		}
+		else if (npaths < 2) paths[npaths++] = argv[i];
+		else usage();
+	}
+	if (npaths != 2) usage();
+	if (cycle < 1 || create < 1 || create > cycle) {
+		fprintf(stderr, "Create must be between 1 and the value of cycle (1 <= create <= cycle)\n");
+		return 2;
+	}
+	if (scene < 0) {
+		fprintf(stderr, "Scene threshold must be >= 0.0\n");
+		return 2;
+	}
+
+	try {
+		auto start = std::chrono::steady_clock::now();
+		Y4MFile y4m(paths[0]);
+		y4m.adviseSequential();
+		const int frames = y4m.frameCount();
+		const int cpuFlags = DetectCPUFlags();
+
+		AnalysisFile analysis;
+		AnalysisHeader& h = analysis.header;
+		memcpy(h.magic, ANALYSIS_FILE_MAGIC, sizeof(h.magic));
+		h.frames = frames;
+		h.width = y4m.width;
+		h.height = y4m.height;
+		h.bits = y4m.bits;
+		h.cycle = cycle;
+		h.creates = create;
+		h.sceneThreshold = scene;
+		analysis.diffs.assign(frames, 0.0f);   // frame 0 has no predecessor, and YDiff compares it to itself
+
+		// Threads claim runs of consecutive frames, so each mapped frame is mostly read by one thread
+		// for both of the diffs it takes part in.
+		std::atomic<int> next(1);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&]() {
+				for (int first = next.fetch_add(FRAMES_PER_TASK); first < frames; first = next.fetch_add(FRAMES_PER_TASK)) {
+					int last = std::min(first + FRAMES_PER_TASK, frames);
+					for (int n = first; n < last; n++) {
+						analysis.diffs[n] = PlaneDiff(y4m.luma(n), y4m.luma(n - 1), y4m.lumaPitch(), y4m.lumaPitch(),
+						                              y4m.lumaPitch(), y4m.height, y4m.pixelSize, y4m.bits, cpuFlags);
+					}
+				}
+			});
+		}
+		for (auto& w : workers) w.join();
+
+		classifyFrames(analysis, selectCycleFactory(cycle, create), cpuFlags);
+		writeAnalysisFile(paths[1], analysis);
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		int bad = static_cast<int>(std::count(analysis.marks.begin(), analysis.marks.end(), '*'));
+		int scenes = static_cast<int>(std::count(analysis.marks.begin(), analysis.marks.end(), 'S'));
+		printf("%d frames (%dx%d, %d-bit) in %.2f s, %.1f frames/s: %d frames to insert before, %d scene changes\n",
+			frames, y4m.width, y4m.height, y4m.bits, seconds, frames / seconds, bad, scenes);
+	}
+	catch (std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+
+// Streaming stutter analysis of raw frames read from a pipe, e.g.
+//
+//   ffmpeg -i live.ts -f rawvideo -pix_fmt yuv420p - | smoothskip_stream --width 1920 --height 1080
+//
+// Frames are diffed as they arrive and every cycle is classified as soon as its last frame is
+// in, so memory use is constant and decisions lag the input by at most one cycle. Each decision
+// is written to stdout as a "frame mark diff" line, the marks as in AnalysisFile.h except that
+// frames without a mark get '-', and stdout is flushed after every cycle.
+//
+//   smoothskip_stream --width W --height H [--format yuv420p] [--cycle 4] [--create 1] [--scene 32] [input|-]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "AnalysisFile.h"
+#include "FixedCycle.h"
+#include "PlaneDiff.h"
+
+#define FRAME_ALIGN 64
+
+// Layout of a raw frame as named by ffmpeg's -pix_fmt.
+struct RawFormat {
+	int bits;
+	int pixelSize;
+	size_t chromaSize;   // bytes of all planes after luma
+};
+
+static bool parseFormat(const char* name, int width, int height, RawFormat& format) {
+	static const struct { const char* prefix; int planes, subX, subY; } layouts[] = {
+		{ "gray", 0, 1, 1 }, { "yuv420p", 2, 2, 2 }, { "yuv422p", 2, 2, 1 }, { "yuv444p", 2, 1, 1 },
+		{ "yuv411p", 2, 4, 1 }, { "nv12", 1, 1, 2 }, { "nv21", 1, 1, 2 },
+	};
+	for (const auto& l : layouts) {
+		size_t len = strlen(l.prefix);
+		if (strncmp(name, l.prefix, len) != 0) continue;
+		const char* suffix = name + len;
+		format.bits = 8;
+		if (*suffix) {
+			// high bit depth variants: <prefix><bits>le, not for the semi-planar formats
+			char* end;
+			format.bits = static_cast<int>(strtol(suffix, &end, 10));
+			if (l.planes == 1 || strcmp(end, "le") != 0 || format.bits < 9 || format.bits > 16) return false;
+		}
+		format.pixelSize = format.bits > 8 ? 2 : 1;
+		// nv12/nv21 interleave both chroma planes into one plane of full width and half height
+		size_t chromaW = l.planes == 1 ? width : (width + l.subX - 1) / l.subX;
+		size_t chromaH = (height + l.subY - 1) / l.subY;
+		format.chromaSize = l.planes * chromaW * chromaH * format.pixelSize;
+		return true;
+	}
+	return false;
+}
+
+// Reads size bytes unless the input ends first, returns the bytes read.
+static size_t readFully(FILE* in, uint8_t* buffer, size_t size) {
+	size_t done = 0;
+	while (done < size) {
+		size_t n = fread(buffer + done, 1, size - done, in);
+		if (n == 0) break;
+		done += n;
+	}
+	return done;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: smoothskip_stream --width W --height H [--format yuv420p] [--cycle N] [--create N] [--scene F] [input|-]\n");
+	exit(2);
+}
+
+int main(int argc, char** argv) {
+	int width = 0, height = 0, cycleLength = 4, create = 1;
+	float scene = 32;
+	const char* formatName = "yuv420p";
+	const char* path = "-";
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-' && argv[i][1] == '-') {
+			if (i + 1 >= argc) usage();
+			const char* value = argv[++i];
+			if (!strcmp(argv[i - 1], "--width")) width = atoi(value);
+			else if (!strcmp(argv[i - 1], "--height")) height = atoi(value);
+			else if (!strcmp(argv[i - 1], "--format")) formatName = value;
+			else if (!strcmp(argv[i - 1], "--cycle")) cycleLength = atoi(value);
+			else if (!strcmp(argv[i - 1], "--create")) create = atoi(value);
+			else if (!strcmp(argv[i - 1], "--scene")) scene = static_cast<float>(atof(value));
+			else usage();
+		}
+		else path = argv[i];
+	}
+	if (width <= 0 || height <= 0) usage();
+	if (cycleLength < 1 || create < 1 || create > cycleLength) {
+		fprintf(stderr, "Create must be between 1 and the value of cycle (1 <= create <= cycle)\n");
+		return 2;
+	}
+	if (scene < 0) {
+		fprintf(stderr, "Scene threshold must be >= 0.0\n");
+		return 2;
+	}
+	RawFormat format;
+	if (!parseFormat(formatName, width, height, format)) {
+		fprintf(stderr, "Unsupported format %s\n", formatName);
+		return 2;
+	}
+
+	FILE* in = stdin;
+	if (strcmp(path, "-") != 0) {
+		in = fopen(path, "rb");
+		if (!in) {
+			fprintf(stderr, "Can't open %s\n", path);
+			return 1;
+		}
+	}
+#ifdef _WIN32
+	else _setmode(_fileno(stdin), _O_BINARY);
+#endif
+	setvbuf(in, nullptr, _IOFBF, 1 << 20);
+
+	// Only the luma of the previous and the current frame is needed for the diffs, so the ring is
+	// two luma planes. Chroma is read into a scratch buffer and dropped. The diffs of the current
+	// cycle are all that is kept until it is classified.
+	const int pitch = width * format.pixelSize;
+	const size_t lumaSize = static_cast<size_t>(pitch) * height;
+	const size_t slotSize = (lumaSize + FRAME_ALIGN - 1) / FRAME_ALIGN * FRAME_ALIGN;
+	std::vector<uint8_t> storage(2 * slotSize + FRAME_ALIGN);
+	uint8_t* ring = storage.data() + (FRAME_ALIGN - reinterpret_cast<uintptr_t>(storage.data()) % FRAME_ALIGN) % FRAME_ALIGN;
+	std::vector<uint8_t> chroma(format.chromaSize);
+
+	const int cpuFlags = DetectCPUFlags();
+	std::unique_ptr<Cycle> cycle = selectCycleFactory(cycleLength, create)(cycleLength, create, 0, scene);
+	std::vector<float> diffs(cycleLength);
+	std::vector<char> marks(cycleLength);
+	int frames = 0, bad = 0, scenes = 0;
+
+	auto emitCycle = [&](int count) {
+		const int start = frames - count;
+		classifyCycle(*cycle, start, diffs.data(), count, marks.data());
+		for (int i = 0; i < count; i++) {
+			printf("%d %c %.4f\n", start + i, marks[i] == ' ' ? '-' : marks[i], diffs[i]);
+			bad += marks[i] == '*';
+			scenes += marks[i] == 'S';
+		}
+		fflush(stdout);
+	};
+
+	for (;;) {
+		uint8_t* luma = ring + (frames & 1) * slotSize;
+		size_t got = readFully(in, luma, lumaSize);
+		if (got == lumaSize) got += readFully(in, chroma.data(), chroma.size());
+		if (got < lumaSize + chroma.size()) {
+			if (got) fprintf(stderr, "Ignoring %zu bytes of a partial frame at the end of the input\n", got);
+			break;
+		}
+
+		const uint8_t* prev = frames ? ring + ((frames - 1) & 1) * slotSize : luma;
+		diffs[frames % cycleLength] = PlaneDiff(luma, prev, pitch, pitch, pitch, height, format.pixelSize, format.bits, cpuFlags);
+		frames++;
+		if (frames % cycleLength == 0) emitCycle(cycleLength);
+	}
+	if (frames % cycleLength) emitCycle(frames % cycleLength);
+	if (in != stdin) fclose(in);
+
+	fprintf(stderr, "%d frames: %d frames to insert before, %d scene changes\n", frames, bad, scenes);
+	return 0;
+}
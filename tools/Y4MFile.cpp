@@ -0,0 +1,147 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "Y4MFile.h"
+
+#define Y4M_MAGIC "YUV4MPEG2"
+#define FRAME_MAGIC "FRAME"
+
+Y4MFile::Y4MFile(const char* path) : data(nullptr), size(0), width(0), height(0), bits(8), pixelSize(1) {
+#ifdef _WIN32
+	mappingHandle = nullptr;
+	fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) throw std::runtime_error(std::string("Can't open ") + path);
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	mappingHandle = size ? CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	data = mappingHandle ? static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) throw std::runtime_error(std::string("Can't open ") + path);
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		size = static_cast<size_t>(st.st_size);
+		void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		data = p == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(p);
+	}
+	close(fd);
+#endif
+	if (!data) {
+		unmap();
+		throw std::runtime_error(std::string("Can't map ") + path);
+	}
+
+	const uint8_t* eol = static_cast<const uint8_t*>(memchr(data, '\n', size));
+	if (size < sizeof(Y4M_MAGIC) || memcmp(data, Y4M_MAGIC, sizeof(Y4M_MAGIC) - 1) != 0 || !eol) {
+		unmap();
+		throw std::runtime_error(std::string(path) + " is not a Y4M file");
+	}
+
+	size_t frameSize;
+	try {
+		parseHeader(std::string(reinterpret_cast<const char*>(data), eol - data), frameSize);
+	}
+	catch (...) {
+		unmap();
+		throw;
+	}
+
+	// Each frame is "FRAME[ params]\n" followed by the planes. A trailing partial frame is ignored.
+	size_t pos = eol - data + 1;
+	while (pos + sizeof(FRAME_MAGIC) - 1 <= size && memcmp(data + pos, FRAME_MAGIC, sizeof(FRAME_MAGIC) - 1) == 0) {
+		eol = static_cast<const uint8_t*>(memchr(data + pos, '\n', size - pos));
+		if (!eol) break;
+		pos = eol - data + 1;
+		if (pos + frameSize > size) break;
+		frameOffsets.push_back(pos);
+		pos += frameSize;
+	}
+}
+
+Y4MFile::~Y4MFile() {
+	unmap();
+}
+
+void Y4MFile::unmap() {
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+	data = nullptr;
+}
+
+void Y4MFile::adviseSequential() {
+#ifndef _WIN32
+	madvise(const_cast<uint8_t*>(data), size, MADV_SEQUENTIAL);
+#endif
+}
+
+void Y4MFile::parseHeader(const std::string& header, size_t& frameSize) {
+	std::string colorspace = "420jpeg";
+	size_t pos = 0;
+	while ((pos = header.find(' ', pos)) != std::string::npos) {
+		size_t end = header.find(' ', ++pos);
+		std::string token = header.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+		if (token.empty()) continue;
+		switch (token[0]) {
+		case 'W': width = atoi(token.c_str() + 1); break;
+		case 'H': height = atoi(token.c_str() + 1); break;
+		case 'C': colorspace = token.substr(1); break;
+		}
+	}
+	if (width <= 0 || height <= 0) throw std::runtime_error("Y4M header lacks the frame size");
+
+	// subsampling, then the optional bit depth: "420p10", "444", "mono16"
+	size_t digits = colorspace.find_first_of("p", 3);
+	bool mono = colorspace.compare(0, 4, "mono") == 0;
+	if (mono && colorspace.size() > 4) bits = atoi(colorspace.c_str() + 4);
+	else if (!mono && digits != std::string::npos && digits + 1 < colorspace.size() && isdigit(colorspace[digits + 1]))
+		bits = atoi(colorspace.c_str() + digits + 1);
+	if (bits < 8 || bits > 16) throw std::runtime_error("Unsupported Y4M bit depth in C" + colorspace);
+	pixelSize = bits > 8 ? 2 : 1;
+
+	size_t luma = size_t(width) * height;
+	size_t chroma;
+	if (mono) chroma = 0;
+	else if (colorspace.compare(0, 3, "420") == 0) chroma = 2 * size_t((width + 1) / 2) * ((height + 1) / 2);
+	else if (colorspace.compare(0, 3, "422") == 0) chroma = 2 * size_t((width + 1) / 2) * height;
+	else if (colorspace.compare(0, 3, "411") == 0) chroma = 2 * size_t((width + 3) / 4) * height;
+	else if (colorspace.compare(0, 8, "444alpha") == 0) chroma = 3 * luma;
+	else if (colorspace.compare(0, 3, "444") == 0) chroma = 2 * luma;
+	else throw std::runtime_error("Unsupported Y4M colorspace C" + colorspace);
+
+	frameSize = (luma + chroma) * pixelSize;
+}
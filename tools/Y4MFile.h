@@ -0,0 +1,62 @@
+// SmoothSkip: AVISynth filter for processing stuttering clips
+// Copyright (C) 2015 Jonas Tingeborn
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Read-only memory mapping of an uncompressed YUV4MPEG2 (.y4m) file. Frame planes are
+ * accessed in place in the mapping, nothing is copied. Throws std::runtime_error if the
+ * file can't be mapped or isn't a supported Y4M file.
+ *
+ * Supported colorspaces: 420 (jpeg, mpeg2, paldv), 411, 422, 444, 444alpha and mono, at 8 bits,
+ * and with a pNN / monoNN suffix at 9-16 bits (little endian 16 bit samples).
+ */
+class Y4MFile {
+	const uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+	std::vector<size_t> frameOffsets;   // offset of the first plane of each frame
+
+	void parseHeader(const std::string& header, size_t& frameSize);
+	void unmap();
+
+public:
+	int width, height;
+	int bits;                // bits per sample
+	int pixelSize;           // bytes per sample
+
+	explicit Y4MFile(const char* path);
+	~Y4MFile();
+	Y4MFile(const Y4MFile&) = delete;
+	Y4MFile& operator=(const Y4MFile&) = delete;
+
+	int frameCount() const { return static_cast<int>(frameOffsets.size()); }
+	const uint8_t* luma(int n) const { return data + frameOffsets[n]; }
+	int lumaPitch() const { return width * pixelSize; }
+
+	// Hints the OS to read ahead, as the frames are read front to back.
+	void adviseSequential();
+};